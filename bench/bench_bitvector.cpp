@@ -0,0 +1,219 @@
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "bitvector.hpp"
+#include "harness.hpp"
+#include "vector.hpp"
+
+//////////////////////////////////////////////////////
+// bitvector benchmarks
+//////////////////////////////////////////////////////
+
+//
+// Against std::vector<bool> (also bit-packed, but no word-level access) and
+// one flag per byte in a rack::vector<uint8_t>.
+//
+
+static const std::vector<uint64_t> SIZES = {1 << 12, 1 << 20, 1 << 24};
+
+// `n` flags, roughly one in `density` set
+static std::vector<bool> randomFlags(uint64_t n, uint64_t density, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<bool> flags(n);
+    for (uint64_t i = 0; i < n; i++) {
+        flags[i] = rng() % density == 0;
+    }
+    return flags;
+}
+
+static rack::bitvector toBits(const std::vector<bool>& flags) {
+    rack::bitvector bv(flags.size());
+    for (size_t i = 0; i < flags.size(); i++) {
+        if (flags[i]) {
+            bv.set(i);
+        }
+    }
+    return bv;
+}
+
+static rack::vector<uint8_t> toBytes(const std::vector<bool>& flags) {
+    rack::vector<uint8_t> bytes(flags.size(), 0);
+    for (size_t i = 0; i < flags.size(); i++) {
+        bytes.data()[i] = flags[i];
+    }
+    return bytes;
+}
+
+//////////////////////////////////////////////////////
+// and - a &= b
+//////////////////////////////////////////////////////
+
+static void bitvector_andStd(bench::state& st) {
+    std::vector<bool> a = randomFlags(st.n(), 2, 1), b = randomFlags(st.n(), 2, 2);
+    while (st.keep_running()) {
+        for (size_t i = 0; i < a.size(); i++) {
+            a[i] = a[i] && b[i];
+        }
+        bench::ClobberMemory();
+    }
+    st.set_items_per_iteration(st.n());
+}
+
+static void bitvector_andBytes(bench::state& st) {
+    rack::vector<uint8_t> a = toBytes(randomFlags(st.n(), 2, 1));
+    rack::vector<uint8_t> b = toBytes(randomFlags(st.n(), 2, 2));
+    while (st.keep_running()) {
+        uint8_t* pa = a.data();
+        const uint8_t* pb = b.data();
+        for (size_t i = 0; i < a.size(); i++) {
+            pa[i] &= pb[i];
+        }
+        bench::ClobberMemory();
+    }
+    st.set_items_per_iteration(st.n());
+}
+
+static void bitvector_andRack(bench::state& st) {
+    rack::bitvector a = toBits(randomFlags(st.n(), 2, 1)), b = toBits(randomFlags(st.n(), 2, 2));
+    while (st.keep_running()) {
+        a &= b;
+        bench::ClobberMemory();
+    }
+    st.set_items_per_iteration(st.n());
+}
+
+//////////////////////////////////////////////////////
+// count - number of set flags
+//////////////////////////////////////////////////////
+
+static void bitvector_countStd(bench::state& st) {
+    std::vector<bool> a = randomFlags(st.n(), 2, 1);
+    while (st.keep_running()) {
+        bench::DoNotOptimize(std::count(a.begin(), a.end(), true));
+    }
+    st.set_items_per_iteration(st.n());
+}
+
+static void bitvector_countBytes(bench::state& st) {
+    rack::vector<uint8_t> a = toBytes(randomFlags(st.n(), 2, 1));
+    while (st.keep_running()) {
+        uint64_t total = 0;
+        const uint8_t* p = a.data();
+        for (size_t i = 0; i < a.size(); i++) {
+            total += p[i];
+        }
+        bench::DoNotOptimize(total);
+    }
+    st.set_items_per_iteration(st.n());
+}
+
+static void bitvector_countRack(bench::state& st) {
+    rack::bitvector a = toBits(randomFlags(st.n(), 2, 1));
+    while (st.keep_running()) {
+        bench::DoNotOptimize(a.count());
+    }
+    st.set_items_per_iteration(st.n());
+}
+
+//////////////////////////////////////////////////////
+// iterate - visit each set flag (1 in 16 set)
+//////////////////////////////////////////////////////
+
+static void bitvector_iterateStd(bench::state& st) {
+    std::vector<bool> a = randomFlags(st.n(), 16, 1);
+    while (st.keep_running()) {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < a.size(); i++) {
+            if (a[i]) {
+                sum += i;
+            }
+        }
+        bench::DoNotOptimize(sum);
+    }
+    st.set_items_per_iteration(st.n());
+}
+
+static void bitvector_iterateBytes(bench::state& st) {
+    rack::vector<uint8_t> a = toBytes(randomFlags(st.n(), 16, 1));
+    while (st.keep_running()) {
+        uint64_t sum = 0;
+        const uint8_t* p = a.data();
+        for (size_t i = 0; i < a.size(); i++) {
+            if (p[i]) {
+                sum += i;
+            }
+        }
+        bench::DoNotOptimize(sum);
+    }
+    st.set_items_per_iteration(st.n());
+}
+
+static void bitvector_iterateRack(bench::state& st) {
+    rack::bitvector a = toBits(randomFlags(st.n(), 16, 1));
+    while (st.keep_running()) {
+        uint64_t sum = 0;
+        for (size_t i : a.set_bits()) {
+            sum += i;
+        }
+        bench::DoNotOptimize(sum);
+    }
+    st.set_items_per_iteration(st.n());
+}
+
+//////////////////////////////////////////////////////
+// rank/select - random queries against the index
+//////////////////////////////////////////////////////
+
+static const uint64_t QUERIES = 1 << 12;
+
+static void bitvector_rank(bench::state& st) {
+    rack::bitvector a = toBits(randomFlags(st.n(), 2, 1));
+    a.build_rank_select();
+    std::mt19937_64 rng(3);
+    std::vector<size_t> queries;
+    for (uint64_t i = 0; i < QUERIES; i++) {
+        queries.push_back(rng() % (st.n() + 1));
+    }
+
+    while (st.keep_running()) {
+        uint64_t sum = 0;
+        for (size_t q : queries) {
+            sum += a.rank(q);
+        }
+        bench::DoNotOptimize(sum);
+    }
+    st.set_items_per_iteration(QUERIES);
+}
+
+static void bitvector_select(bench::state& st) {
+    rack::bitvector a = toBits(randomFlags(st.n(), 2, 1));
+    a.build_rank_select();
+    std::mt19937_64 rng(3);
+    std::vector<size_t> queries;
+    for (uint64_t i = 0; i < QUERIES; i++) {
+        queries.push_back(rng() % a.count());
+    }
+
+    while (st.keep_running()) {
+        uint64_t sum = 0;
+        for (size_t q : queries) {
+            sum += a.select(q);
+        }
+        bench::DoNotOptimize(sum);
+    }
+    st.set_items_per_iteration(QUERIES);
+}
+
+static bool registered =
+       bench::add("bitvector/and", "std", "bit", SIZES, bitvector_andStd)
+    && bench::add("bitvector/and", "rack_bytes", "bit", SIZES, bitvector_andBytes)
+    && bench::add("bitvector/and", "rack", "bit", SIZES, bitvector_andRack)
+    && bench::add("bitvector/count", "std", "bit", SIZES, bitvector_countStd)
+    && bench::add("bitvector/count", "rack_bytes", "bit", SIZES, bitvector_countBytes)
+    && bench::add("bitvector/count", "rack", "bit", SIZES, bitvector_countRack)
+    && bench::add("bitvector/iterate", "std", "bit", SIZES, bitvector_iterateStd)
+    && bench::add("bitvector/iterate", "rack_bytes", "bit", SIZES, bitvector_iterateBytes)
+    && bench::add("bitvector/iterate", "rack", "bit", SIZES, bitvector_iterateRack)
+    && bench::add("bitvector/rank", "rack", "bit", SIZES, bitvector_rank)
+    && bench::add("bitvector/select", "rack", "bit", SIZES, bitvector_select);
@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "atomic_shared_ptr.hpp"
+#include "epoch.hpp"
+#include "harness.hpp"
+#include "shared_ptr.hpp"
+
+//////////////////////////////////////////////////////
+// atomic_shared_ptr benchmarks
+//////////////////////////////////////////////////////
+
+struct Config {
+    int version;
+    int routes[16];
+    Config(int v) : version(v) {}
+};
+
+//
+// `n` readers, one writer publishing a new config every `writePeriod`.
+// Reports per-load reader latency percentiles as counters.
+//
+template <typename LoadFn, typename StoreFn>
+static void atomic_shared_ptr_readers(bench::state& st, LoadFn load, StoreFn store) {
+    const uint64_t loadsPerReader = 200'000;
+    const auto writePeriod = std::chrono::microseconds(50);
+
+    while (st.keep_running()) {
+        std::atomic<bool> done{false};
+        std::vector<std::vector<uint32_t>> latencies(st.n());
+
+        std::thread writer([&]() {
+            int v = 0;
+            while (!done.load(std::memory_order_relaxed)) {
+                store(rack::make_shared<Config>(++v));
+                std::this_thread::sleep_for(writePeriod);
+            }
+        });
+
+        std::vector<std::thread> readers;
+        for (uint64_t r = 0; r < st.n(); r++) {
+            readers.emplace_back([&, r]() {
+                std::vector<uint32_t>& lat = latencies[r];
+                lat.reserve(loadsPerReader);
+                for (uint64_t i = 0; i < loadsPerReader; i++) {
+                    auto start = std::chrono::steady_clock::now();
+                    rack::shared_ptr<Config> cfg = load();
+                    auto end = std::chrono::steady_clock::now();
+                    bench::DoNotOptimize(cfg);
+                    lat.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+                }
+            });
+        }
+        for (auto& t : readers) {
+            t.join();
+        }
+        done.store(true);
+        writer.join();
+
+        std::vector<uint32_t> all;
+        for (auto& lat : latencies) {
+            all.insert(all.end(), lat.begin(), lat.end());
+        }
+        std::sort(all.begin(), all.end());
+        auto pct = [&](double p) { return all[(size_t)(p * (all.size() - 1))]; };
+
+        st.counter("load_p50_ns", pct(0.50));
+        st.counter("load_p99_ns", pct(0.99));
+        st.counter("load_p99.9_ns", pct(0.999));
+        st.counter("load_max_ns", all.back());
+    }
+    st.set_items_per_iteration(st.n() * loadsPerReader);
+}
+
+//////////////////////////////////////////////////////
+// epoch benchmarks
+//////////////////////////////////////////////////////
+
+//
+// `n` retiring threads, with two readers entering and leaving guards alongside.
+// Reports how many retired objects are held back (pending()) as counters.
+//
+static void epoch_retire(bench::state& st) {
+    const uint64_t retiresPerThread = 500'000;
+    const int nReaders = 2;
+
+    while (st.keep_running()) {
+        std::atomic<bool> done{false};
+        std::atomic<int*> published{new int(0)};
+
+        std::vector<std::thread> readers;
+        for (int r = 0; r < nReaders; r++) {
+            readers.emplace_back([&]() {
+                while (!done.load(std::memory_order_relaxed)) {
+                    rack::epoch::guard g;
+                    bench::DoNotOptimize(*published.load(std::memory_order_acquire));
+                }
+            });
+        }
+
+        size_t peak = 0;
+        double sum = 0;
+        int samples = 0;
+        std::thread sampler([&]() {
+            while (!done.load(std::memory_order_relaxed)) {
+                size_t p = rack::epoch::pending();
+                peak = std::max(peak, p);
+                sum += p;
+                samples++;
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        });
+
+        std::vector<std::thread> writers;
+        for (uint64_t t = 0; t < st.n(); t++) {
+            writers.emplace_back([&]() {
+                for (uint64_t i = 0; i < retiresPerThread; i++) {
+                    int* old = published.exchange(new int(i), std::memory_order_acq_rel);
+                    rack::epoch::retire(old);
+                }
+            });
+        }
+        for (auto& t : writers) {
+            t.join();
+        }
+
+        done = true;
+        for (auto& t : readers) {
+            t.join();
+        }
+        sampler.join();
+        rack::epoch::retire(published.load());
+        rack::epoch::synchronize();
+
+        st.counter("pending_peak", peak);
+        st.counter("pending_mean", samples ? sum / samples : 0);
+    }
+    st.set_items_per_iteration(st.n() * retiresPerThread);
+}
+
+static bool concurrency_register() {
+    std::vector<uint64_t> threads;
+    uint64_t maxThreads = std::max(2u, std::thread::hardware_concurrency());
+    for (uint64_t n = 1; n <= maxThreads; n *= 2) {
+        threads.push_back(n);
+    }
+
+    bench::add("atomic_shared_ptr/readers", "mutex", "config", threads, [](bench::state& st) {
+        std::mutex mtx;
+        rack::shared_ptr<Config> cfg = rack::make_shared<Config>(0);
+        atomic_shared_ptr_readers(st,
+            [&]() { std::lock_guard<std::mutex> lk(mtx); return cfg; },
+            [&](rack::shared_ptr<Config> next) { std::lock_guard<std::mutex> lk(mtx); cfg = next; });
+    }, 1);
+    bench::add("atomic_shared_ptr/readers", "rack", "config", threads, [](bench::state& st) {
+        rack::atomic_shared_ptr<Config> cfg(rack::make_shared<Config>(0));
+        atomic_shared_ptr_readers(st,
+            [&]() { return cfg.load(); },
+            [&](rack::shared_ptr<Config> next) { cfg.store(next); });
+    }, 1);
+
+    bench::add("epoch/retire", "rack", "int", threads, epoch_retire, 1);
+    return true;
+}
+
+static bool registered = concurrency_register();
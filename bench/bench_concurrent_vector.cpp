@@ -0,0 +1,81 @@
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "concurrent_vector.hpp"
+#include "harness.hpp"
+#include "types.hpp"
+#include "vector.hpp"
+
+//////////////////////////////////////////////////////
+// concurrent_vector benchmarks
+//////////////////////////////////////////////////////
+
+static const uint64_t TOTAL_APPENDS = 1 << 20;
+
+//
+// `n` threads append TOTAL_APPENDS elements between them to one shared
+// container, from empty. `append(c, val)` does one append.
+//
+template <class Container, class T, class AppendFn>
+static void appendThreads(bench::state& st, AppendFn append) {
+    T val = bench::make_value<T>(1);
+    uint64_t perThread = TOTAL_APPENDS / st.n();
+
+    while (st.keep_running()) {
+        Container c;
+        std::vector<std::thread> threads;
+        for (uint64_t t = 0; t < st.n(); t++) {
+            threads.emplace_back([&]() {
+                for (uint64_t i = 0; i < perThread; i++) {
+                    append(c, val);
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        bench::ClobberMemory();
+    }
+    st.set_items_per_iteration(perThread * st.n());
+}
+
+template <class Vec>
+struct Locked {
+    std::mutex mtx;
+    Vec vec;
+};
+
+template <class T>
+static bool concurrentVector_register() {
+    std::vector<uint64_t> threads;
+    uint64_t maxThreads = std::max(2u, std::thread::hardware_concurrency());
+    for (uint64_t n = 1; n <= maxThreads; n *= 2) {
+        threads.push_back(n);
+    }
+    const char* t = bench::type_name<T>();
+
+    bench::add("concurrent_vector/append", "std", t, threads, [](bench::state& st) {
+        appendThreads<Locked<std::vector<T>>, T>(st, [](Locked<std::vector<T>>& c, const T& v) {
+            std::lock_guard<std::mutex> lk(c.mtx);
+            c.vec.push_back(v);
+        });
+    }, 1);
+    bench::add("concurrent_vector/append", "rack_vector_mutex", t, threads, [](bench::state& st) {
+        appendThreads<Locked<rack::vector<T>>, T>(st, [](Locked<rack::vector<T>>& c, const T& v) {
+            std::lock_guard<std::mutex> lk(c.mtx);
+            c.vec.push_back(v);
+        });
+    }, 1);
+    bench::add("concurrent_vector/append", "rack", t, threads, [](bench::state& st) {
+        appendThreads<rack::concurrent_vector<T>, T>(st, [](rack::concurrent_vector<T>& c, const T& v) {
+            c.push_back(v);
+        });
+    }, 1);
+    return true;
+}
+
+static bool registered = concurrentVector_register<uint64_t>()
+                      && concurrentVector_register<Payload64>();
@@ -0,0 +1,86 @@
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "deque.hpp"
+#include "harness.hpp"
+#include "types.hpp"
+
+//////////////////////////////////////////////////////
+// deque benchmarks
+//////////////////////////////////////////////////////
+
+static const std::vector<uint64_t> SIZES = {1 << 10, 1 << 16, 1 << 20};
+
+// Builds an `n`-element deque by push_back, from empty.
+template <class Deque>
+static void deque_pushBack(bench::state& st) {
+    using T = typename std::decay<decltype(std::declval<Deque>().front())>::type;
+    T val = bench::make_value<T>(1);
+
+    while (st.keep_running()) {
+        Deque d;
+        for (uint64_t i = 0; i < st.n(); i++) {
+            d.push_back(val);
+        }
+        bench::DoNotOptimize(d.back());
+    }
+    st.set_items_per_iteration(st.n());
+}
+
+// Builds an `n`-element deque by push_front, from empty.
+template <class Deque>
+static void deque_pushFront(bench::state& st) {
+    using T = typename std::decay<decltype(std::declval<Deque>().front())>::type;
+    T val = bench::make_value<T>(1);
+
+    while (st.keep_running()) {
+        Deque d;
+        for (uint64_t i = 0; i < st.n(); i++) {
+            d.push_front(val);
+        }
+        bench::DoNotOptimize(d.front());
+    }
+    st.set_items_per_iteration(st.n());
+}
+
+//
+// FIFO churn - push `n` to the back, then pop all `n` from the front.
+//
+// NOTE: A fresh deque each iteration - rack::deque doesn't yet reuse chunks
+//       behind the front, so one long-lived FIFO would grow without bound.
+//
+template <class Deque>
+static void deque_fifo(bench::state& st) {
+    using T = typename std::decay<decltype(std::declval<Deque>().front())>::type;
+    T val = bench::make_value<T>(1);
+
+    while (st.keep_running()) {
+        Deque d;
+        for (uint64_t i = 0; i < st.n(); i++) {
+            d.push_back(val);
+        }
+        while (!d.empty()) {
+            bench::DoNotOptimize(d.front());
+            d.pop_front();
+        }
+    }
+    st.set_items_per_iteration(st.n());
+}
+
+template <class T>
+static bool deque_register() {
+    const char* t = bench::type_name<T>();
+    bench::add("deque/push_back", "std", t, SIZES, deque_pushBack<std::deque<T>>);
+    bench::add("deque/push_back", "rack", t, SIZES, deque_pushBack<rack::deque<T>>);
+    bench::add("deque/push_front", "std", t, SIZES, deque_pushFront<std::deque<T>>);
+    bench::add("deque/push_front", "rack", t, SIZES, deque_pushFront<rack::deque<T>>);
+    bench::add("deque/fifo", "std", t, SIZES, deque_fifo<std::deque<T>>);
+    bench::add("deque/fifo", "rack", t, SIZES, deque_fifo<rack::deque<T>>);
+    return true;
+}
+
+static bool registered = deque_register<int>()
+                      && deque_register<Payload64>()
+                      && deque_register<std::string>();
@@ -0,0 +1,218 @@
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "flat_hash_map.hpp"
+#include "harness.hpp"
+#include "types.hpp"
+
+//////////////////////////////////////////////////////
+// flat_hash_map benchmarks
+//////////////////////////////////////////////////////
+
+//
+// `n` is the table size (slots, or buckets for std::unordered_map, whose
+// max_load_factor is set to 1 so the two are comparable). Each case is
+// registered per load factor - the fraction of those `n` that is filled.
+//
+static const std::vector<uint64_t> SIZES = {1 << 10, 1 << 14, 1 << 18};
+static const std::vector<int> LOAD_PERCENT = {25, 50, 75, 85};
+
+template <class K, class V>
+static void presize(std::unordered_map<K, V>& m, uint64_t slots) {
+    m.max_load_factor(1.0f);
+    m.rehash(slots);
+}
+
+template <class K, class V>
+static void presize(rack::flat_hash_map<K, V>& m, uint64_t slots) {
+    m.rehash(slots);
+}
+
+// `count` distinct random keys, and a further `count` distinct from those.
+template <class K>
+static void makeKeys(uint64_t count, std::vector<K>& keys, std::vector<K>& others) {
+    std::mt19937_64 rng(42);
+    std::vector<uint64_t> raw;
+    while (raw.size() < 2 * count) {
+        while (raw.size() < 2 * count) {
+            raw.push_back(rng());
+        }
+        std::sort(raw.begin(), raw.end());
+        raw.erase(std::unique(raw.begin(), raw.end()), raw.end());
+    }
+    std::shuffle(raw.begin(), raw.end(), rng);
+
+    keys.clear();
+    others.clear();
+    for (uint64_t i = 0; i < count; i++) {
+        keys.push_back(bench::make_value<K>(raw[i]));
+        others.push_back(bench::make_value<K>(raw[count + i]));
+    }
+}
+
+static uint64_t fillCount(bench::state& st, int loadPercent) {
+    return std::max<uint64_t>(1, st.n() * loadPercent / 100);
+}
+
+// Looks up every key present, in random order.
+template <class Map>
+static void hashMap_findHit(bench::state& st, int loadPercent) {
+    using K = typename Map::key_type;
+    std::vector<K> keys, others;
+    makeKeys(fillCount(st, loadPercent), keys, others);
+
+    Map m;
+    presize(m, st.n());
+    for (uint64_t i = 0; i < keys.size(); i++) {
+        m[keys[i]] = i;
+    }
+    std::shuffle(keys.begin(), keys.end(), std::mt19937_64(1));
+
+    while (st.keep_running()) {
+        uint64_t sum = 0;
+        for (const K& k : keys) {
+            sum += m.find(k)->second;
+        }
+        bench::DoNotOptimize(sum);
+    }
+    st.set_items_per_iteration(keys.size());
+}
+
+// Looks up as many keys that are absent.
+template <class Map>
+static void hashMap_findMiss(bench::state& st, int loadPercent) {
+    using K = typename Map::key_type;
+    std::vector<K> keys, others;
+    makeKeys(fillCount(st, loadPercent), keys, others);
+
+    Map m;
+    presize(m, st.n());
+    for (uint64_t i = 0; i < keys.size(); i++) {
+        m[keys[i]] = i;
+    }
+
+    while (st.keep_running()) {
+        uint64_t found = 0;
+        for (const K& k : others) {
+            found += m.find(k) != m.end();
+        }
+        bench::DoNotOptimize(found);
+    }
+    st.set_items_per_iteration(others.size());
+}
+
+// Fills a presized, empty table up to the load factor.
+template <class Map>
+static void hashMap_insert(bench::state& st, int loadPercent) {
+    using K = typename Map::key_type;
+    std::vector<K> keys, others;
+    makeKeys(fillCount(st, loadPercent), keys, others);
+
+    while (st.keep_running()) {
+        st.pause_timing();
+        {
+            Map m;
+            presize(m, st.n());
+            st.resume_timing();
+
+            for (uint64_t i = 0; i < keys.size(); i++) {
+                m.insert({keys[i], i});
+            }
+            bench::DoNotOptimize(m.size());
+            st.pause_timing(); // not the teardown
+        }
+        st.resume_timing();
+    }
+    st.set_items_per_iteration(keys.size());
+}
+
+// Empties a table at the load factor, one key at a time in random order.
+template <class Map>
+static void hashMap_erase(bench::state& st, int loadPercent) {
+    using K = typename Map::key_type;
+    std::vector<K> keys, others;
+    makeKeys(fillCount(st, loadPercent), keys, others);
+
+    while (st.keep_running()) {
+        st.pause_timing();
+        {
+            Map m;
+            presize(m, st.n());
+            for (uint64_t i = 0; i < keys.size(); i++) {
+                m[keys[i]] = i;
+            }
+            st.resume_timing();
+
+            for (const K& k : keys) {
+                m.erase(k);
+            }
+            bench::DoNotOptimize(m.size());
+            st.pause_timing();
+        }
+        st.resume_timing();
+    }
+    st.set_items_per_iteration(keys.size());
+}
+
+//
+// Steady state at the load factor - each item erases the oldest key and
+// inserts a new one (so tombstones accumulate, for rack::flat_hash_map).
+//
+template <class Map>
+static void hashMap_churn(bench::state& st, int loadPercent) {
+    using K = typename Map::key_type;
+    std::vector<K> keys, others;
+    makeKeys(fillCount(st, loadPercent), keys, others);
+
+    std::vector<K> ring(keys);
+    ring.insert(ring.end(), others.begin(), others.end());
+    uint64_t count = keys.size();
+
+    Map m;
+    presize(m, st.n());
+    for (uint64_t i = 0; i < count; i++) {
+        m[keys[i]] = i;
+    }
+
+    uint64_t base = 0;
+    while (st.keep_running()) {
+        for (uint64_t j = 0; j < count; j++) {
+            m.erase(ring[(base + j) % ring.size()]);
+            m.insert({ring[(base + count + j) % ring.size()], j});
+        }
+        base += count;
+        bench::DoNotOptimize(m.size());
+    }
+    st.set_items_per_iteration(count);
+}
+
+template <class K>
+static bool hashMap_register() {
+    using Std = std::unordered_map<K, uint64_t>;
+    using Rack = rack::flat_hash_map<K, uint64_t>;
+    const char* t = bench::type_name<K>();
+
+    for (int lf : LOAD_PERCENT) {
+        std::string suffix = "/lf" + std::to_string(lf);
+        auto add = [&](const std::string& op, void (*fnStd)(bench::state&, int),
+                                              void (*fnRack)(bench::state&, int)) {
+            bench::add("hash_map/" + op + suffix, "std", t, SIZES,
+                       [=](bench::state& st) { fnStd(st, lf); });
+            bench::add("hash_map/" + op + suffix, "rack", t, SIZES,
+                       [=](bench::state& st) { fnRack(st, lf); });
+        };
+        add("find_hit", hashMap_findHit<Std>, hashMap_findHit<Rack>);
+        add("find_miss", hashMap_findMiss<Std>, hashMap_findMiss<Rack>);
+        add("insert", hashMap_insert<Std>, hashMap_insert<Rack>);
+        add("erase", hashMap_erase<Std>, hashMap_erase<Rack>);
+        add("churn", hashMap_churn<Std>, hashMap_churn<Rack>);
+    }
+    return true;
+}
+
+static bool registered = hashMap_register<uint64_t>()
+                      && hashMap_register<std::string>();
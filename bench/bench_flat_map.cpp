@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "flat_map.hpp"
+#include "harness.hpp"
+#include "types.hpp"
+
+//////////////////////////////////////////////////////
+// flat_map benchmarks
+//////////////////////////////////////////////////////
+
+static const std::vector<uint64_t> SIZES = {1 << 10, 1 << 16, 1 << 20};
+
+template <class K>
+using FlatBranchless = rack::flat_map<K, uint64_t, std::less<K>, rack::branchless_search>;
+
+template <class K>
+using FlatEytzinger = rack::flat_map<K, uint64_t, std::less<K>, rack::eytzinger_search>;
+
+// `n` unsorted (key, value) pairs with distinct keys.
+template <class K>
+static std::vector<std::pair<K, uint64_t>> makePairs(uint64_t n, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<std::pair<K, uint64_t>> pairs;
+    for (uint64_t i = 0; i < n; i++) {
+        pairs.push_back({bench::make_value<K>(rng()), i});
+    }
+    return pairs;
+}
+
+// Looks up every key present, in random order.
+template <class Map>
+static void flatMap_find(bench::state& st) {
+    using K = typename Map::key_type;
+    auto pairs = makePairs<K>(st.n(), 42);
+    Map m(pairs.begin(), pairs.end());
+
+    std::vector<K> keys;
+    for (auto& kv : pairs) {
+        keys.push_back(kv.first);
+    }
+    std::shuffle(keys.begin(), keys.end(), std::mt19937_64(1));
+
+    while (st.keep_running()) {
+        uint64_t sum = 0;
+        for (const K& k : keys) {
+            sum += m.find(k)->second;
+        }
+        bench::DoNotOptimize(sum);
+    }
+    st.set_items_per_iteration(keys.size());
+}
+
+// Builds the map from `n` unsorted pairs.
+template <class Map>
+static void flatMap_build(bench::state& st) {
+    using K = typename Map::key_type;
+    auto pairs = makePairs<K>(st.n(), 42);
+
+    while (st.keep_running()) {
+        Map m(pairs.begin(), pairs.end());
+        bench::DoNotOptimize(m.size());
+    }
+    st.set_items_per_iteration(st.n());
+}
+
+// Adds a batch of n / 8 new pairs to an `n`-element map.
+template <class Map>
+static void flatMap_merge(bench::state& st) {
+    using K = typename Map::key_type;
+    auto pairs = makePairs<K>(st.n(), 42);
+    auto batch = makePairs<K>(st.n() / 8, 7);
+    Map base(pairs.begin(), pairs.end());
+
+    while (st.keep_running()) {
+        st.pause_timing();
+        Map m(base);
+        st.resume_timing();
+
+        m.insert(batch.begin(), batch.end());
+        bench::DoNotOptimize(m.size());
+    }
+    st.set_items_per_iteration(batch.size());
+}
+
+template <class K>
+static bool flatMap_register() {
+    const char* t = bench::type_name<K>();
+    bench::add("flat_map/find", "std", t, SIZES, flatMap_find<std::map<K, uint64_t>>);
+    bench::add("flat_map/find", "rack", t, SIZES, flatMap_find<FlatBranchless<K>>);
+    bench::add("flat_map/find", "rack_eytzinger", t, SIZES, flatMap_find<FlatEytzinger<K>>);
+    bench::add("flat_map/build", "std", t, SIZES, flatMap_build<std::map<K, uint64_t>>);
+    bench::add("flat_map/build", "rack", t, SIZES, flatMap_build<FlatBranchless<K>>);
+    bench::add("flat_map/merge", "std", t, SIZES, flatMap_merge<std::map<K, uint64_t>>);
+    bench::add("flat_map/merge", "rack", t, SIZES, flatMap_merge<FlatBranchless<K>>);
+    return true;
+}
+
+static bool registered = flatMap_register<uint64_t>()
+                      && flatMap_register<std::string>();
@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "deque.hpp"
+#include "harness.hpp"
+#include "mpmc_queue.hpp"
+
+//////////////////////////////////////////////////////
+// mpmc_queue benchmarks
+//////////////////////////////////////////////////////
+
+//
+// `n` producers and `n` consumers move TOTAL_ITEMS u64s through one shared
+// queue. Producers/consumers that find it full/empty yield and retry (or,
+// for the blocking variants, sleep on the futex).
+//
+// "std" is a std::deque behind a std::mutex; "rack_deque_mutex" the same
+// with rack::deque - what the ingest tier used before.
+//
+
+static const uint64_t TOTAL_ITEMS = 1 << 18;
+static const size_t BOUNDED_CAPACITY = 1024;
+static const size_t BATCH = 32;
+
+//
+// Runs the producers and consumers. `produce(first, count)` must push all of
+// [first, first + count); `consume(out, max)` pops up to `max` into `out`
+// and returns how many.
+//
+template <class ProduceFn, class ConsumeFn>
+static void runQueue(bench::state& st, ProduceFn produce, ConsumeFn consume, size_t batch) {
+    uint64_t perThread = TOTAL_ITEMS / st.n();
+    std::vector<uint64_t> items(perThread);
+    for (uint64_t i = 0; i < perThread; i++) {
+        items[i] = i;
+    }
+
+    std::vector<std::thread> threads;
+    for (uint64_t t = 0; t < st.n(); t++) {
+        threads.emplace_back([&]() {
+            for (uint64_t i = 0; i < perThread; i += batch) {
+                produce(items.data() + i, std::min<uint64_t>(batch, perThread - i));
+            }
+        });
+        threads.emplace_back([&]() {
+            uint64_t buf[BATCH];
+            uint64_t sum = 0;
+            for (uint64_t got = 0; got < perThread;) {
+                size_t k = consume(buf, std::min<uint64_t>(batch, perThread - got));
+                for (size_t j = 0; j < k; j++) {
+                    sum += buf[j];
+                }
+                got += k;
+            }
+            bench::DoNotOptimize(sum);
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+template <class Deque>
+struct LockedQueue {
+    std::mutex mtx;
+    Deque q;
+
+    void produce(const uint64_t* first, size_t count) {
+        std::lock_guard<std::mutex> lk(mtx);
+        for (size_t i = 0; i < count; i++) {
+            q.push_back(first[i]);
+        }
+    }
+
+    size_t consume(uint64_t* out, size_t max) {
+        size_t k = 0;
+        {
+            std::lock_guard<std::mutex> lk(mtx);
+            for (; k < max && !q.empty(); k++) {
+                out[k] = q.front();
+                q.pop_front();
+            }
+        }
+        if (k == 0) {
+            std::this_thread::yield();
+        }
+        return k;
+    }
+};
+
+template <class Deque>
+static void mpmc_locked(bench::state& st) {
+    while (st.keep_running()) {
+        LockedQueue<Deque> q;
+        runQueue(st,
+            [&](const uint64_t* first, size_t count) { q.produce(first, count); },
+            [&](uint64_t* out, size_t max) { return q.consume(out, max); }, 1);
+    }
+    st.set_items_per_iteration(TOTAL_ITEMS / st.n() * st.n());
+}
+
+static void mpmc_bounded(bench::state& st) {
+    while (st.keep_running()) {
+        rack::mpmc_queue<uint64_t> q(BOUNDED_CAPACITY);
+        runQueue(st,
+            [&](const uint64_t* first, size_t) {
+                while (!q.try_push(*first)) {
+                    std::this_thread::yield();
+                }
+            },
+            [&](uint64_t* out, size_t) {
+                if (q.try_pop(*out)) {
+                    return size_t(1);
+                }
+                std::this_thread::yield();
+                return size_t(0);
+            }, 1);
+    }
+    st.set_items_per_iteration(TOTAL_ITEMS / st.n() * st.n());
+}
+
+static void mpmc_boundedBatch(bench::state& st) {
+    while (st.keep_running()) {
+        rack::mpmc_queue<uint64_t> q(BOUNDED_CAPACITY);
+        runQueue(st,
+            [&](const uint64_t* first, size_t count) {
+                while (count > 0) {
+                    size_t k = q.try_push_bulk(first, count);
+                    if (k == 0) {
+                        std::this_thread::yield();
+                    }
+                    first += k;
+                    count -= k;
+                }
+            },
+            [&](uint64_t* out, size_t max) {
+                size_t k = q.try_pop_bulk(out, max);
+                if (k == 0) {
+                    std::this_thread::yield();
+                }
+                return k;
+            }, BATCH);
+    }
+    st.set_items_per_iteration(TOTAL_ITEMS / st.n() * st.n());
+}
+
+static void mpmc_boundedBlocking(bench::state& st) {
+    while (st.keep_running()) {
+        rack::mpmc_queue<uint64_t, true> q(BOUNDED_CAPACITY);
+        runQueue(st,
+            [&](const uint64_t* first, size_t) { q.push(*first); },
+            [&](uint64_t* out, size_t) {
+                q.pop(*out);
+                return size_t(1);
+            }, 1);
+    }
+    st.set_items_per_iteration(TOTAL_ITEMS / st.n() * st.n());
+}
+
+static void mpmc_unbounded(bench::state& st) {
+    while (st.keep_running()) {
+        rack::unbounded_mpmc_queue<uint64_t> q;
+        runQueue(st,
+            [&](const uint64_t* first, size_t) { q.push(*first); },
+            [&](uint64_t* out, size_t) {
+                if (q.try_pop(*out)) {
+                    return size_t(1);
+                }
+                std::this_thread::yield();
+                return size_t(0);
+            }, 1);
+    }
+    st.set_items_per_iteration(TOTAL_ITEMS / st.n() * st.n());
+}
+
+static void mpmc_unboundedBatch(bench::state& st) {
+    while (st.keep_running()) {
+        rack::unbounded_mpmc_queue<uint64_t> q;
+        runQueue(st,
+            [&](const uint64_t* first, size_t count) { q.push_bulk(first, count); },
+            [&](uint64_t* out, size_t max) {
+                size_t k = q.try_pop_bulk(out, max);
+                if (k == 0) {
+                    std::this_thread::yield();
+                }
+                return k;
+            }, BATCH);
+    }
+    st.set_items_per_iteration(TOTAL_ITEMS / st.n() * st.n());
+}
+
+static bool mpmc_register() {
+    std::vector<uint64_t> threads;
+    uint64_t maxThreads = std::max(2u, std::thread::hardware_concurrency());
+    for (uint64_t n = 1; n <= maxThreads; n *= 2) {
+        threads.push_back(n);
+    }
+
+    bench::add("mpmc_queue/transfer", "std", "u64", threads, mpmc_locked<std::deque<uint64_t>>, 1);
+    bench::add("mpmc_queue/transfer", "rack_deque_mutex", "u64", threads,
+               mpmc_locked<rack::deque<uint64_t>>, 1);
+    bench::add("mpmc_queue/transfer", "rack_bounded", "u64", threads, mpmc_bounded, 1);
+    bench::add("mpmc_queue/transfer", "rack_bounded_batch", "u64", threads, mpmc_boundedBatch, 1);
+    bench::add("mpmc_queue/transfer", "rack_bounded_blocking", "u64", threads, mpmc_boundedBlocking, 1);
+    bench::add("mpmc_queue/transfer", "rack_unbounded", "u64", threads, mpmc_unbounded, 1);
+    bench::add("mpmc_queue/transfer", "rack_unbounded_batch", "u64", threads, mpmc_unboundedBatch, 1);
+    return true;
+}
+
+static bool registered = mpmc_register();
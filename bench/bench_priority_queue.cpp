@@ -0,0 +1,186 @@
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "harness.hpp"
+#include "priority_queue.hpp"
+#include "types.hpp"
+
+//////////////////////////////////////////////////////
+// priority_queue benchmarks
+//////////////////////////////////////////////////////
+
+static const std::vector<uint64_t> SIZES = {1 << 10, 1 << 16, 1 << 20};
+
+template <class T>
+static std::vector<T> randomValues(uint64_t n) {
+    std::mt19937_64 rng(42);
+    std::vector<T> vals;
+    for (uint64_t i = 0; i < n; i++) {
+        vals.push_back(bench::make_value<T>(rng()));
+    }
+    return vals;
+}
+
+// Pushes `n` random elements, then pops them all.
+template <class PQ, class T>
+static void pq_pushPop(bench::state& st) {
+    std::vector<T> vals = randomValues<T>(st.n());
+
+    while (st.keep_running()) {
+        PQ pq;
+        for (const T& v : vals) {
+            pq.push(v);
+        }
+        while (!pq.empty()) {
+            bench::DoNotOptimize(pq.top());
+            pq.pop();
+        }
+    }
+    st.set_items_per_iteration(st.n());
+}
+
+// 'Hold' model - a queue of `n` elements, each item pops the top and pushes a later one.
+template <class PQ, class T>
+static void pq_hold(bench::state& st) {
+    std::vector<T> vals = randomValues<T>(st.n());
+    PQ pq(vals.begin(), vals.end());
+
+    std::mt19937_64 rng(7);
+    std::vector<uint64_t> steps;
+    for (int i = 0; i < 1024; i++) {
+        steps.push_back(rng() % 1024);
+    }
+
+    const uint64_t items = 1024;
+    while (st.keep_running()) {
+        for (uint64_t i = 0; i < items; i++) {
+            T next = pq.top() + steps[i];
+            pq.pop();
+            pq.push(next);
+        }
+        bench::DoNotOptimize(pq.top());
+    }
+    st.set_items_per_iteration(items);
+}
+
+// Builds a queue from `n` unordered elements in bulk.
+template <class PQ, class T>
+static void pq_heapify(bench::state& st) {
+    std::vector<T> vals = randomValues<T>(st.n());
+
+    while (st.keep_running()) {
+        PQ pq(vals.begin(), vals.end());
+        bench::DoNotOptimize(pq.top());
+    }
+    st.set_items_per_iteration(st.n());
+}
+
+//
+// Dijkstra-style relaxation on `n` queued keys - lower a random element's key,
+// then every so often pop the minimum. std::priority_queue has no
+// decrease-key, so it pushes a duplicate and skips stale entries on pop.
+//
+static void pq_decreaseKeyStd(bench::state& st) {
+    using Entry = std::pair<uint64_t, uint32_t>; // key, id
+    std::vector<uint64_t> vals = randomValues<uint64_t>(st.n());
+
+    while (st.keep_running()) {
+        st.pause_timing();
+        std::vector<uint64_t> key(vals);
+        std::vector<bool> done(vals.size(), false);
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> pq;
+        for (uint32_t i = 0; i < vals.size(); i++) {
+            pq.push({key[i], i});
+        }
+        std::mt19937_64 rng(7);
+        st.resume_timing();
+
+        for (uint64_t i = 0; i < st.n(); i++) {
+            uint32_t id = rng() % vals.size();
+            if (!done[id]) {
+                key[id] /= 2;
+                pq.push({key[id], id});
+            }
+            if (i % 4 == 3) {
+                while (done[pq.top().second] || pq.top().first != key[pq.top().second]) {
+                    pq.pop();
+                }
+                done[pq.top().second] = true;
+                pq.pop();
+            }
+        }
+        bench::DoNotOptimize(pq.size());
+    }
+    st.set_items_per_iteration(st.n());
+}
+
+template <uint32_t D>
+static void pq_decreaseKeyRack(bench::state& st) {
+    std::vector<uint64_t> vals = randomValues<uint64_t>(st.n());
+
+    while (st.keep_running()) {
+        st.pause_timing();
+        std::vector<uint64_t> key(vals);
+        std::vector<uint32_t> handles;
+        rack::indexed_priority_queue<uint64_t, std::greater<uint64_t>, D> pq;
+        pq.heapify(vals.begin(), vals.end(), std::back_inserter(handles));
+        std::mt19937_64 rng(7);
+        st.resume_timing();
+
+        for (uint64_t i = 0; i < st.n(); i++) {
+            uint32_t id = rng() % vals.size();
+            if (pq.contains(handles[id])) {
+                key[id] /= 2;
+                pq.decrease_key(handles[id], key[id]);
+            }
+            if (i % 4 == 3) {
+                pq.pop();
+            }
+        }
+        bench::DoNotOptimize(pq.size());
+    }
+    st.set_items_per_iteration(st.n());
+}
+
+template <class T>
+static bool pq_register() {
+    using Std = std::priority_queue<T>;
+    using Rack2 = rack::priority_queue<T, std::less<T>, 2>;
+    using Rack4 = rack::priority_queue<T, std::less<T>, 4>;
+    using Rack8 = rack::priority_queue<T, std::less<T>, 8>;
+    const char* t = bench::type_name<T>();
+
+    bench::add("priority_queue/push_pop", "std", t, SIZES, pq_pushPop<Std, T>);
+    bench::add("priority_queue/push_pop", "rack_d2", t, SIZES, pq_pushPop<Rack2, T>);
+    bench::add("priority_queue/push_pop", "rack_d4", t, SIZES, pq_pushPop<Rack4, T>);
+    bench::add("priority_queue/push_pop", "rack_d8", t, SIZES, pq_pushPop<Rack8, T>);
+    bench::add("priority_queue/heapify", "std", t, SIZES, pq_heapify<Std, T>);
+    bench::add("priority_queue/heapify", "rack_d4", t, SIZES, pq_heapify<Rack4, T>);
+    bench::add("priority_queue/heapify", "rack_d8", t, SIZES, pq_heapify<Rack8, T>);
+    return true;
+}
+
+template <class T>
+static bool pq_registerArithmetic() {
+    using Std = std::priority_queue<T>;
+    using Rack4 = rack::priority_queue<T, std::less<T>, 4>;
+    using Rack8 = rack::priority_queue<T, std::less<T>, 8>;
+    const char* t = bench::type_name<T>();
+
+    bench::add("priority_queue/hold", "std", t, SIZES, pq_hold<Std, T>);
+    bench::add("priority_queue/hold", "rack_d4", t, SIZES, pq_hold<Rack4, T>);
+    bench::add("priority_queue/hold", "rack_d8", t, SIZES, pq_hold<Rack8, T>);
+    return true;
+}
+
+static bool registered = pq_register<uint64_t>()
+                      && pq_register<std::string>()
+                      && pq_registerArithmetic<uint64_t>()
+                      && bench::add("priority_queue/decrease_key", "std", "u64", SIZES,
+                                    pq_decreaseKeyStd)
+                      && bench::add("priority_queue/decrease_key", "rack_d4", "u64", SIZES,
+                                    pq_decreaseKeyRack<4>);
@@ -0,0 +1,160 @@
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include <unistd.h>
+
+#include "deque.hpp"
+#include "harness.hpp"
+#include "serialize.hpp"
+#include "types.hpp"
+#include "vector.hpp"
+
+//////////////////////////////////////////////////////
+// serialization benchmarks
+//////////////////////////////////////////////////////
+
+//
+// Round trip - write an `n`-element container to a temporary file, then read
+// it back into a fresh one. The file lives in the page cache, so this measures
+// the copying and syscalls rather than the disk. `GB/s` is container bytes
+// per second of round trip.
+//
+// "std" is what we did before - element by element through buffered stdio.
+//
+
+static const std::vector<uint64_t> SIZES = {1 << 10, 1 << 16, 1 << 20};
+
+struct TempFile {
+    FILE* f = std::tmpfile();
+    int fd = fileno(f);
+
+    ~TempFile() {
+        std::fclose(f);
+    }
+
+    void restart() {
+        std::fflush(f);
+        std::rewind(f);
+        lseek(fd, 0, SEEK_SET);
+    }
+};
+
+static void reportThroughput(bench::state& st, uint64_t bytes) {
+    st.set_items_per_iteration(st.n());
+    st.counter("GB/s", bytes * st.iterations() / st.elapsed_ns());
+}
+
+template <class T>
+static void serialize_vectorStd(bench::state& st) {
+    rack::vector<T> src;
+    for (uint64_t i = 0; i < st.n(); i++) {
+        src.push_back(bench::make_value<T>(i));
+    }
+    TempFile tmp;
+
+    while (st.keep_running()) {
+        tmp.restart();
+        uint64_t count = src.size();
+        std::fwrite(&count, sizeof(count), 1, tmp.f);
+        for (uint32_t i = 0; i < src.size(); i++) {
+            std::fwrite(&src[i], sizeof(T), 1, tmp.f);
+        }
+        tmp.restart();
+
+        rack::vector<T> dst;
+        std::fread(&count, sizeof(count), 1, tmp.f);
+        dst.reserve(count);
+        for (uint64_t i = 0; i < count; i++) {
+            T val;
+            std::fread(&val, sizeof(T), 1, tmp.f);
+            dst.push_back(val);
+        }
+        bench::DoNotOptimize(dst.data());
+    }
+    reportThroughput(st, sizeof(T) * st.n());
+}
+
+template <class T>
+static void serialize_vectorRack(bench::state& st) {
+    rack::vector<T> src;
+    for (uint64_t i = 0; i < st.n(); i++) {
+        src.push_back(bench::make_value<T>(i));
+    }
+    TempFile tmp;
+
+    while (st.keep_running()) {
+        tmp.restart();
+        rack::serialize::write(tmp.fd, src);
+        tmp.restart();
+
+        rack::vector<T> dst;
+        rack::serialize::read(tmp.fd, dst);
+        bench::DoNotOptimize(dst.data());
+    }
+    reportThroughput(st, sizeof(T) * st.n());
+}
+
+template <class T>
+static void serialize_dequeStd(bench::state& st) {
+    rack::deque<T> src;
+    for (uint64_t i = 0; i < st.n(); i++) {
+        src.push_back(bench::make_value<T>(i));
+    }
+    TempFile tmp;
+
+    while (st.keep_running()) {
+        tmp.restart();
+        uint64_t count = src.size();
+        std::fwrite(&count, sizeof(count), 1, tmp.f);
+        src.for_each_segment([&](const T* first, uint32_t n) {
+            for (uint32_t i = 0; i < n; i++) {
+                std::fwrite(first + i, sizeof(T), 1, tmp.f);
+            }
+        });
+        tmp.restart();
+
+        rack::deque<T> dst;
+        std::fread(&count, sizeof(count), 1, tmp.f);
+        for (uint64_t i = 0; i < count; i++) {
+            T val;
+            std::fread(&val, sizeof(T), 1, tmp.f);
+            dst.push_back(val);
+        }
+        bench::DoNotOptimize(dst.back());
+    }
+    reportThroughput(st, sizeof(T) * st.n());
+}
+
+template <class T>
+static void serialize_dequeRack(bench::state& st) {
+    rack::deque<T> src;
+    for (uint64_t i = 0; i < st.n(); i++) {
+        src.push_back(bench::make_value<T>(i));
+    }
+    TempFile tmp;
+
+    while (st.keep_running()) {
+        tmp.restart();
+        rack::serialize::write(tmp.fd, src);
+        tmp.restart();
+
+        rack::deque<T> dst;
+        rack::serialize::read(tmp.fd, dst);
+        bench::DoNotOptimize(dst.back());
+    }
+    reportThroughput(st, sizeof(T) * st.n());
+}
+
+template <class T>
+static bool serialize_register() {
+    const char* t = bench::type_name<T>();
+    bench::add("serialize/vector", "std", t, SIZES, serialize_vectorStd<T>);
+    bench::add("serialize/vector", "rack", t, SIZES, serialize_vectorRack<T>);
+    bench::add("serialize/deque", "std", t, SIZES, serialize_dequeStd<T>);
+    bench::add("serialize/deque", "rack", t, SIZES, serialize_dequeRack<T>);
+    return true;
+}
+
+static bool registered = serialize_register<uint64_t>()
+                      && serialize_register<Payload64>();
@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "harness.hpp"
+#include "shared_ptr.hpp"
+
+//////////////////////////////////////////////////////
+// shared_ptr benchmarks
+//////////////////////////////////////////////////////
+
+// Copy then release a pointer made on this thread (biased's fast path).
+template <class Ptr, class Make>
+static void shared_ptr_copy(bench::state& st, Make make) {
+    Ptr sp = make();
+    while (st.keep_running()) {
+        Ptr copy = sp;
+        bench::DoNotOptimize(copy);
+    }
+    st.set_items_per_iteration(1);
+}
+
+//
+// Copy then release from `n` threads that didn't create the pointer (biased's
+// slow path, and contended for every policy).
+//
+template <class Ptr, class Make>
+static void shared_ptr_copyShared(bench::state& st, Make make) {
+    const uint64_t perThread = 1'000'000;
+    Ptr sp = make();
+
+    while (st.keep_running()) {
+        std::vector<std::thread> threads;
+        for (uint64_t t = 0; t < st.n(); t++) {
+            threads.emplace_back([&]() {
+                for (uint64_t i = 0; i < perThread; i++) {
+                    Ptr copy = sp;
+                    bench::DoNotOptimize(copy);
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+    }
+    rack::brc_collect();
+    st.set_items_per_iteration(st.n() * perThread);
+}
+
+// Create then destroy, with a ring of live pointers so frees aren't always LIFO.
+template <class Ptr, class Make>
+static void shared_ptr_make(bench::state& st, Make make) {
+    const int live = 64;
+    std::vector<Ptr> ring(live);
+    uint64_t i = 0;
+    while (st.keep_running()) {
+        ring[i++ % live] = make();
+    }
+    st.set_items_per_iteration(1);
+}
+
+// Create/destroy throughput at `n` threads, with control blocks from `BlockAllocator`.
+template <class BlockAllocator>
+static void shared_ptr_makeThreads(bench::state& st) {
+    using Ptr = rack::shared_ptr<int, rack::atomic_refcount, BlockAllocator>;
+    const uint64_t perThread = 1'000'000;
+    const int live = 64;
+
+    while (st.keep_running()) {
+        std::vector<std::thread> threads;
+        for (uint64_t t = 0; t < st.n(); t++) {
+            threads.emplace_back([&]() {
+                std::vector<Ptr> ring(live);
+                for (uint64_t i = 0; i < perThread; i++) {
+                    ring[i % live] = rack::make_shared<int, rack::atomic_refcount, BlockAllocator>(i);
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+    }
+
+    st.set_items_per_iteration(st.n() * perThread);
+}
+
+static std::vector<uint64_t> threadSweep() {
+    std::vector<uint64_t> sweep;
+    uint64_t maxThreads = std::max(2u, std::thread::hardware_concurrency());
+    for (uint64_t n = 1; n <= maxThreads; n *= 2) {
+        sweep.push_back(n);
+    }
+    return sweep;
+}
+
+static bool shared_ptr_register() {
+    using StdPtr = std::shared_ptr<int>;
+    using AtomicPtr = rack::shared_ptr<int>;
+    using BiasedPtr = rack::shared_ptr<int, rack::biased_refcount>;
+
+    auto makeStd = []() { return std::make_shared<int>(1); };
+    auto makeAtomic = []() { return rack::make_shared<int>(1); };
+    auto makeBiased = []() { return rack::make_shared<int, rack::biased_refcount>(1); };
+
+    bench::add("shared_ptr/copy", "std", "int", {1},
+               [=](bench::state& st) { shared_ptr_copy<StdPtr>(st, makeStd); });
+    bench::add("shared_ptr/copy", "rack_atomic", "int", {1},
+               [=](bench::state& st) { shared_ptr_copy<AtomicPtr>(st, makeAtomic); });
+    bench::add("shared_ptr/copy", "rack_biased", "int", {1},
+               [=](bench::state& st) { shared_ptr_copy<BiasedPtr>(st, makeBiased); });
+
+    std::vector<uint64_t> threads = threadSweep();
+    bench::add("shared_ptr/copy_shared", "std", "int", threads,
+               [=](bench::state& st) { shared_ptr_copyShared<StdPtr>(st, makeStd); }, 1);
+    bench::add("shared_ptr/copy_shared", "rack_atomic", "int", threads,
+               [=](bench::state& st) { shared_ptr_copyShared<AtomicPtr>(st, makeAtomic); }, 1);
+    bench::add("shared_ptr/copy_shared", "rack_biased", "int", threads,
+               [=](bench::state& st) { shared_ptr_copyShared<BiasedPtr>(st, makeBiased); }, 1);
+
+    bench::add("shared_ptr/make", "std", "int", {1},
+               [=](bench::state& st) { shared_ptr_make<StdPtr>(st, makeStd); });
+    bench::add("shared_ptr/make", "rack", "int", {1},
+               [=](bench::state& st) { shared_ptr_make<AtomicPtr>(st, makeAtomic); });
+
+    bench::add("shared_ptr/make_threads", "rack_new_delete", "int", threads,
+               [](bench::state& st) { shared_ptr_makeThreads<rack::new_delete_block_allocator>(st); }, 1);
+    bench::add("shared_ptr/make_threads", "rack_slab_pool", "int", threads,
+               [](bench::state& st) { shared_ptr_makeThreads<rack::pool_block_allocator>(st); }, 1);
+    return true;
+}
+
+static bool registered = shared_ptr_register();
@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "harness.hpp"
+#include "stable_vector.hpp"
+#include "types.hpp"
+
+//////////////////////////////////////////////////////
+// stable_vector benchmarks
+//////////////////////////////////////////////////////
+
+//
+// Against std::vector (contiguous, but moves on growth) and std::deque (the
+// usual choice for stable references).
+//
+
+static const std::vector<uint64_t> SIZES = {1 << 10, 1 << 16, 1 << 20};
+
+template <class Vec>
+static Vec filled(uint64_t n) {
+    using T = typename Vec::value_type;
+    Vec v;
+    for (uint64_t i = 0; i < n; i++) {
+        v.push_back(bench::make_value<T>(i));
+    }
+    return v;
+}
+
+// Builds an `n`-element container by push_back, from empty.
+template <class Vec>
+static void stableVector_pushBack(bench::state& st) {
+    using T = typename Vec::value_type;
+    T val = bench::make_value<T>(1);
+
+    while (st.keep_running()) {
+        Vec v;
+        for (uint64_t i = 0; i < st.n(); i++) {
+            v.push_back(val);
+        }
+        bench::DoNotOptimize(&v.back());
+        bench::ClobberMemory();
+    }
+    st.set_items_per_iteration(st.n());
+}
+
+// Sums an `n`-element container through its iterators.
+template <class Vec>
+static void stableVector_iterate(bench::state& st) {
+    using T = typename Vec::value_type;
+    Vec v = filled<Vec>(st.n());
+
+    while (st.keep_running()) {
+        T sum = 0;
+        for (auto it = v.begin(); it != v.end(); ++it) {
+            sum += *it;
+        }
+        bench::DoNotOptimize(sum);
+    }
+    st.set_items_per_iteration(st.n());
+}
+
+// Sums an `n`-element stable_vector a chunk at a time.
+template <class T>
+static void stableVector_iterateSegments(bench::state& st) {
+    rack::stable_vector<T> v = filled<rack::stable_vector<T>>(st.n());
+
+    while (st.keep_running()) {
+        T sum = 0;
+        v.for_each_segment([&](const T* first, uint32_t count) {
+            for (uint32_t i = 0; i < count; i++) {
+                sum += first[i];
+            }
+        });
+        bench::DoNotOptimize(sum);
+    }
+    st.set_items_per_iteration(st.n());
+}
+
+// Sums an `n`-element container through operator[], in random order.
+template <class Vec>
+static void stableVector_indexRandom(bench::state& st) {
+    using T = typename Vec::value_type;
+    Vec v = filled<Vec>(st.n());
+    std::vector<uint32_t> order(st.n());
+    for (uint32_t i = 0; i < st.n(); i++) {
+        order[i] = i;
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937_64(1));
+
+    while (st.keep_running()) {
+        T sum = 0;
+        for (uint32_t i : order) {
+            sum += v[i];
+        }
+        bench::DoNotOptimize(sum);
+    }
+    st.set_items_per_iteration(st.n());
+}
+
+template <class T>
+static bool stableVector_register() {
+    const char* t = bench::type_name<T>();
+    bench::add("stable_vector/push_back", "std", t, SIZES, stableVector_pushBack<std::vector<T>>);
+    bench::add("stable_vector/push_back", "std_deque", t, SIZES, stableVector_pushBack<std::deque<T>>);
+    bench::add("stable_vector/push_back", "rack", t, SIZES, stableVector_pushBack<rack::stable_vector<T>>);
+    return true;
+}
+
+template <class T>
+static bool stableVector_registerArithmetic() {
+    const char* t = bench::type_name<T>();
+    bench::add("stable_vector/iterate", "std", t, SIZES, stableVector_iterate<std::vector<T>>);
+    bench::add("stable_vector/iterate", "std_deque", t, SIZES, stableVector_iterate<std::deque<T>>);
+    bench::add("stable_vector/iterate", "rack", t, SIZES, stableVector_iterate<rack::stable_vector<T>>);
+    bench::add("stable_vector/iterate", "rack_segments", t, SIZES, stableVector_iterateSegments<T>);
+    bench::add("stable_vector/index_random", "std", t, SIZES, stableVector_indexRandom<std::vector<T>>);
+    bench::add("stable_vector/index_random", "std_deque", t, SIZES, stableVector_indexRandom<std::deque<T>>);
+    bench::add("stable_vector/index_random", "rack", t, SIZES, stableVector_indexRandom<rack::stable_vector<T>>);
+    return true;
+}
+
+static bool registered = stableVector_register<uint64_t>()
+                      && stableVector_register<Payload64>()
+                      && stableVector_register<std::string>()
+                      && stableVector_registerArithmetic<uint64_t>();
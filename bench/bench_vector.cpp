@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "harness.hpp"
+#include "types.hpp"
+#include "vector.hpp"
+
+//////////////////////////////////////////////////////
+// vector benchmarks
+//////////////////////////////////////////////////////
+
+static const std::vector<uint64_t> SIZES = {1 << 10, 1 << 16, 1 << 20};
+static const std::vector<uint64_t> LATENCY_SIZES = {1 << 20, 1 << 23};
+
+// Builds an `n`-element vector by push_back, from empty.
+template <class Vec>
+static void vector_pushBack(bench::state& st) {
+    using T = typename std::decay<decltype(*std::declval<Vec>().begin())>::type;
+    T val = bench::make_value<T>(1);
+
+    while (st.keep_running()) {
+        Vec v;
+        for (uint64_t i = 0; i < st.n(); i++) {
+            v.push_back(val);
+        }
+        bench::DoNotOptimize(v.data());
+        bench::ClobberMemory();
+    }
+    st.set_items_per_iteration(st.n());
+}
+
+// Sums an `n`-element vector through its iterators.
+template <class Vec>
+static void vector_iterate(bench::state& st) {
+    using T = typename std::decay<decltype(*std::declval<Vec>().begin())>::type;
+    Vec v;
+    for (uint64_t i = 0; i < st.n(); i++) {
+        v.push_back(bench::make_value<T>(i));
+    }
+
+    while (st.keep_running()) {
+        T sum = 0;
+        for (auto it = v.begin(); it != v.end(); ++it) {
+            sum += *it;
+        }
+        bench::DoNotOptimize(sum);
+    }
+    st.set_items_per_iteration(st.n());
+}
+
+// Sums an `n`-element vector through operator[].
+template <class Vec>
+static void vector_index(bench::state& st) {
+    using T = typename std::decay<decltype(*std::declval<Vec>().begin())>::type;
+    Vec v;
+    for (uint64_t i = 0; i < st.n(); i++) {
+        v.push_back(bench::make_value<T>(i));
+    }
+
+    while (st.keep_running()) {
+        T sum = 0;
+        for (uint32_t i = 0; i < st.n(); i++) {
+            sum += v[i];
+        }
+        bench::DoNotOptimize(sum);
+    }
+    st.set_items_per_iteration(st.n());
+}
+
+//
+// Builds an `n`-element vector by push_back, timing every push. Reports the
+// per-push latency distribution as counters - the growth pushes are the tail.
+// (ns/item includes the timer reads.)
+//
+template <class Vec>
+static void vector_pushLatency(bench::state& st) {
+    using T = typename std::decay<decltype(*std::declval<Vec>().begin())>::type;
+    T val = bench::make_value<T>(1);
+    std::vector<uint32_t> lat(st.n());
+
+    while (st.keep_running()) {
+        Vec v;
+        for (uint64_t i = 0; i < st.n(); i++) {
+            auto start = std::chrono::steady_clock::now();
+            v.push_back(val);
+            auto end = std::chrono::steady_clock::now();
+            lat[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        }
+        bench::DoNotOptimize(&v.back());
+        bench::ClobberMemory();
+
+        st.pause_timing();
+        std::sort(lat.begin(), lat.end());
+        auto pct = [&](double p) { return lat[(size_t)(p * (lat.size() - 1))]; };
+        st.counter("push_p50_ns", pct(0.50));
+        st.counter("push_p99.99_ns", pct(0.9999));
+        st.counter("push_max_ns", lat.back());
+        st.resume_timing();
+    }
+    st.set_items_per_iteration(st.n());
+}
+
+template <class T>
+static bool vector_register() {
+    const char* t = bench::type_name<T>();
+    bench::add("vector/push_back", "std", t, SIZES, vector_pushBack<std::vector<T>>);
+    bench::add("vector/push_back", "rack", t, SIZES, vector_pushBack<rack::vector<T>>);
+    bench::add("vector/push_back", "rack_incremental", t, SIZES, vector_pushBack<rack::vector<T, true>>);
+    bench::add("vector/push_latency", "std", t, LATENCY_SIZES, vector_pushLatency<std::vector<T>>);
+    bench::add("vector/push_latency", "rack", t, LATENCY_SIZES, vector_pushLatency<rack::vector<T>>);
+    bench::add("vector/push_latency", "rack_incremental", t, LATENCY_SIZES,
+               vector_pushLatency<rack::vector<T, true>>);
+    return true;
+}
+
+template <class T>
+static bool vector_registerArithmetic() {
+    const char* t = bench::type_name<T>();
+    bench::add("vector/iterate", "std", t, SIZES, vector_iterate<std::vector<T>>);
+    bench::add("vector/iterate", "rack", t, SIZES, vector_iterate<rack::vector<T>>);
+    bench::add("vector/index", "std", t, SIZES, vector_index<std::vector<T>>);
+    bench::add("vector/index", "rack", t, SIZES, vector_index<rack::vector<T>>);
+    return true;
+}
+
+static bool registered = vector_register<int>()
+                      && vector_register<Payload64>()
+                      && vector_register<std::string>()
+                      && vector_registerArithmetic<int>()
+                      && vector_registerArithmetic<uint64_t>();
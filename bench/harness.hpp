@@ -0,0 +1,470 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "perf_counters.hpp"
+
+//
+// Minimal benchmark harness for the `bench` target.
+//
+// Cases are registered with bench::add(), once per value of a swept parameter
+// `n` (usually an element count). Each case is run as:
+//      - calibration - grow the iteration count until one sample takes at
+//        least `--min-time` ms;
+//      - warmup - discard samples for `--warmup` ms AND;
+//      - `--repetitions` timed samples.
+//
+// Per-iteration min/median/mean/p99/stddev are reported, along with ns per
+// item (when a case says how many items an iteration processes), and the
+// ratio against the matching `std` case (same family, type and n).
+//
+// Results can be written as JSON and CSV (`--json=<path>`, `--csv=<path>`)
+// to diff across commits. `--filter=<substr>` runs a subset.
+//
+// `--perf` also reads hardware counters (see perf_counters.hpp) around each
+// sample, reported per item next to the timings.
+//
+namespace bench {
+
+//////////////////////////////////////////////////////
+// Optimisation barriers
+//////////////////////////////////////////////////////
+
+// Forces `value` to be materialised, without otherwise costing anything.
+template <class T>
+inline void DoNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+template <class T>
+inline void DoNotOptimize(T& value) {
+    asm volatile("" : "+r,m"(value) : : "memory");
+}
+
+// Forces all pending writes to memory to be treated as observable.
+inline void ClobberMemory() {
+    asm volatile("" : : : "memory");
+}
+
+//////////////////////////////////////////////////////
+// State
+//////////////////////////////////////////////////////
+
+//
+// Handed to each case. The case runs its timed body inside
+//
+//      while (st.keep_running()) { ... }
+//
+// and may pause timing around per-iteration setup.
+//
+class state {
+private:
+    using clock = std::chrono::steady_clock;
+
+    uint64_t _n;
+    uint64_t _iterations;
+    uint64_t _remaining;
+    double _itemsPerIteration = 0;
+
+    clock::time_point _start;
+    clock::time_point _pausedAt;
+    double _pausedNs = 0;
+    double _elapsedNs = 0;
+
+    std::vector<std::pair<std::string, double>> _counters;
+
+    perf_counters* _perf;
+
+public:
+    state(uint64_t n, uint64_t iterations, perf_counters* perf = nullptr)
+        : _n(n), _iterations(iterations), _remaining(iterations), _perf(perf) {}
+
+    // Swept parameter for this case.
+    uint64_t n() const { return _n; }
+    uint64_t iterations() const { return _iterations; }
+
+    bool keep_running() {
+        if (_remaining == _iterations) {
+            if (_perf) {
+                _perf->start();
+            }
+            _start = clock::now();
+        }
+        if (_remaining == 0) {
+            _elapsedNs = std::chrono::duration<double, std::nano>(clock::now() - _start).count()
+                         - _pausedNs;
+            if (_perf) {
+                _perf->pause();
+            }
+            return false;
+        }
+        _remaining--;
+        return true;
+    }
+
+    void pause_timing() {
+        if (_perf) {
+            _perf->pause();
+        }
+        _pausedAt = clock::now();
+    }
+
+    void resume_timing() {
+        _pausedNs += std::chrono::duration<double, std::nano>(clock::now() - _pausedAt).count();
+        if (_perf) {
+            _perf->resume();
+        }
+    }
+
+    // Items (e.g. elements) processed per iteration, for per-item figures.
+    void set_items_per_iteration(double items) {
+        _itemsPerIteration = items;
+    }
+
+    // Extra figure to report for this case (averaged over samples).
+    void counter(const std::string& name, double value) {
+        for (auto& c : _counters) {
+            if (c.first == name) {
+                c.second = value;
+                return;
+            }
+        }
+        _counters.emplace_back(name, value);
+    }
+
+    double elapsed_ns() const { return _elapsedNs; }
+    double items_per_iteration() const { return _itemsPerIteration; }
+    const std::vector<std::pair<std::string, double>>& counters() const { return _counters; }
+};
+
+//////////////////////////////////////////////////////
+// Registration
+//////////////////////////////////////////////////////
+
+struct case_def {
+    std::string family;   // e.g. "vector/push_back"
+    std::string impl;     // e.g. "rack", "std"
+    std::string type;     // element type, e.g. "int"
+    uint64_t n;
+    std::function<void(state&)> fn;
+    uint64_t fixedIterations; // 0 => calibrate
+
+    std::string name() const {
+        return family + "/" + impl + "<" + type + ">/" + std::to_string(n);
+    }
+};
+
+inline std::vector<case_def>& registry() {
+    static std::vector<case_def> cases;
+    return cases;
+}
+
+//
+// Registers `fn` once per value in `sweep`. Cases that run a whole scenario per
+// call (e.g. spawning threads) should pass `fixedIterations` = 1.
+//
+inline bool add(const std::string& family, const std::string& impl, const std::string& type,
+                const std::vector<uint64_t>& sweep, std::function<void(state&)> fn,
+                uint64_t fixedIterations = 0) {
+    for (uint64_t n : sweep) {
+        registry().push_back({family, impl, type, n, fn, fixedIterations});
+    }
+    return true;
+}
+
+// Printable element type names for parameter sweeps.
+template <class T> inline const char* type_name();
+template <> inline const char* type_name<int>() { return "int"; }
+template <> inline const char* type_name<uint64_t>() { return "u64"; }
+template <> inline const char* type_name<std::string>() { return "string"; }
+
+//////////////////////////////////////////////////////
+// Running
+//////////////////////////////////////////////////////
+
+struct options {
+    std::string filter;
+    int repetitions = 10;
+    double minTimeMs = 10;
+    double warmupMs = 20;
+    std::string jsonPath;
+    std::string csvPath;
+    bool perf = false;
+};
+
+struct result {
+    const case_def* def;
+    uint64_t iterations;
+    double minNs, medianNs, meanNs, p99Ns, stddevNs; // per iteration
+    double itemsPerIteration;
+    double vsStd; // median / std median (0 if no baseline)
+    std::vector<std::pair<std::string, double>> counters;
+
+    double nsPerItem() const {
+        return itemsPerIteration > 0 ? medianNs / itemsPerIteration : 0;
+    }
+};
+
+inline options parse_args(int argc, char** argv) {
+    options opts;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&](const char* key) -> const char* {
+            size_t len = std::strlen(key);
+            return arg.compare(0, len, key) == 0 ? arg.c_str() + len : nullptr;
+        };
+        if (const char* v = value("--filter=")) opts.filter = v;
+        else if (const char* v = value("--repetitions=")) opts.repetitions = std::max(1, std::atoi(v));
+        else if (const char* v = value("--min-time=")) opts.minTimeMs = std::atof(v);
+        else if (const char* v = value("--warmup=")) opts.warmupMs = std::atof(v);
+        else if (const char* v = value("--json=")) opts.jsonPath = v;
+        else if (const char* v = value("--csv=")) opts.csvPath = v;
+        else if (arg == "--perf") opts.perf = true;
+        else {
+            std::cerr << "usage: bench [--filter=<substr>] [--repetitions=<n>] [--min-time=<ms>]"
+                         " [--warmup=<ms>] [--json=<path>] [--csv=<path>] [--perf]\n";
+            std::exit(1);
+        }
+    }
+    return opts;
+}
+
+// Runs one sample of `def` for `iterations` iterations.
+inline state run_sample(const case_def& def, uint64_t iterations, perf_counters* perf = nullptr) {
+    state st(def.n, iterations, perf);
+    def.fn(st);
+    return st;
+}
+
+inline result run_case(const case_def& def, const options& opts, perf_counters* perf) {
+    // calibrate
+    uint64_t iterations = def.fixedIterations ? def.fixedIterations : 1;
+    if (!def.fixedIterations) {
+        while (true) {
+            double ns = run_sample(def, iterations).elapsed_ns();
+            if (ns >= opts.minTimeMs * 1e6 || iterations >= (1ull << 40)) {
+                break;
+            }
+            double scale = ns > 0 ? (opts.minTimeMs * 1e6 * 1.2) / ns : 10;
+            iterations = std::max<uint64_t>(iterations + 1, iterations * std::min(scale, 10.0));
+        }
+    }
+
+    // warmup
+    double warmedNs = 0;
+    while (warmedNs < opts.warmupMs * 1e6) {
+        double ns = run_sample(def, iterations).elapsed_ns();
+        warmedNs += std::max(ns, 1.0);
+        if (def.fixedIterations) {
+            break; // scenario cases - one warmup run is enough
+        }
+    }
+
+    // samples
+    std::vector<double> perIter;
+    std::map<std::string, double> counterSums;
+    std::vector<std::string> counterOrder;
+    double items = 0;
+    for (int r = 0; r < opts.repetitions; r++) {
+        state st = run_sample(def, iterations, perf);
+        perIter.push_back(st.elapsed_ns() / iterations);
+        items = st.items_per_iteration();
+
+        // hardware counters, per item (or per iteration, if the case has no items)
+        if (perf) {
+            double per = iterations * (items > 0 ? items : 1);
+            const char* unit = items > 0 ? "/item" : "/iter";
+            double cycles = 0, instructions = 0;
+            for (auto& rd : perf->read()) {
+                st.counter(std::string(rd.name) + unit, rd.value / per);
+                if (std::strcmp(rd.name, "cycles") == 0) cycles = rd.value;
+                if (std::strcmp(rd.name, "instructions") == 0) instructions = rd.value;
+            }
+            if (cycles > 0 && instructions > 0) {
+                st.counter("ipc", instructions / cycles);
+            }
+        }
+
+        for (auto& c : st.counters()) {
+            if (!counterSums.count(c.first)) {
+                counterOrder.push_back(c.first);
+            }
+            counterSums[c.first] += c.second;
+        }
+    }
+
+    std::vector<double> sorted = perIter;
+    std::sort(sorted.begin(), sorted.end());
+    double mean = 0;
+    for (double v : sorted) mean += v;
+    mean /= sorted.size();
+    double var = 0;
+    for (double v : sorted) var += (v - mean) * (v - mean);
+    double stddev = sorted.size() > 1 ? std::sqrt(var / (sorted.size() - 1)) : 0;
+
+    auto pct = [&](double p) {
+        double idx = p * (sorted.size() - 1);
+        size_t lo = static_cast<size_t>(idx);
+        size_t hi = std::min(lo + 1, sorted.size() - 1);
+        return sorted[lo] + (sorted[hi] - sorted[lo]) * (idx - lo);
+    };
+
+    result res{&def, iterations, sorted.front(), pct(0.5), mean, pct(0.99), stddev, items, 0, {}};
+    for (auto& name : counterOrder) {
+        res.counters.emplace_back(name, counterSums[name] / opts.repetitions);
+    }
+    return res;
+}
+
+//////////////////////////////////////////////////////
+// Reporting
+//////////////////////////////////////////////////////
+
+inline std::string format_ns(double ns) {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(ns < 10 ? 2 : (ns < 1000 ? 1 : 0)) << ns;
+    return oss.str();
+}
+
+inline void print_header() {
+    std::cout << std::left << std::setw(48) << "case"
+              << std::right << std::setw(14) << "median ns"
+              << std::setw(14) << "p99 ns"
+              << std::setw(9) << "cv %"
+              << std::setw(12) << "ns/item"
+              << std::setw(10) << "vs std" << "\n"
+              << std::string(107, '-') << "\n";
+}
+
+inline void print_result(const result& r) {
+    std::ostringstream cv, vs;
+    cv << std::fixed << std::setprecision(1) << (r.meanNs > 0 ? 100 * r.stddevNs / r.meanNs : 0);
+    if (r.vsStd > 0) {
+        vs << std::fixed << std::setprecision(2) << r.vsStd << "x";
+    }
+
+    std::cout << std::left << std::setw(48) << r.def->name()
+              << std::right << std::setw(14) << format_ns(r.medianNs)
+              << std::setw(14) << format_ns(r.p99Ns)
+              << std::setw(9) << cv.str()
+              << std::setw(12) << (r.itemsPerIteration > 0 ? format_ns(r.nsPerItem()) : "")
+              << std::setw(10) << vs.str() << "\n";
+    if (!r.counters.empty()) {
+        std::cout << "   ";
+        for (auto& c : r.counters) {
+            std::cout << " " << c.first << "=" << std::setprecision(4) << c.second;
+        }
+        std::cout << "\n";
+    }
+}
+
+inline std::string json_escape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+inline void write_json(const std::string& path, const std::vector<result>& results) {
+    std::ofstream out(path);
+    out << std::setprecision(10) << "{\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const result& r = results[i];
+        out << "    {\"name\": \"" << json_escape(r.def->name()) << "\""
+            << ", \"family\": \"" << json_escape(r.def->family) << "\""
+            << ", \"impl\": \"" << json_escape(r.def->impl) << "\""
+            << ", \"type\": \"" << json_escape(r.def->type) << "\""
+            << ", \"n\": " << r.def->n
+            << ", \"iterations\": " << r.iterations
+            << ", \"min_ns\": " << r.minNs
+            << ", \"median_ns\": " << r.medianNs
+            << ", \"mean_ns\": " << r.meanNs
+            << ", \"p99_ns\": " << r.p99Ns
+            << ", \"stddev_ns\": " << r.stddevNs
+            << ", \"ns_per_item\": " << r.nsPerItem()
+            << ", \"vs_std\": " << r.vsStd
+            << ", \"counters\": {";
+        for (size_t c = 0; c < r.counters.size(); c++) {
+            out << (c ? ", " : "") << "\"" << json_escape(r.counters[c].first) << "\": "
+                << r.counters[c].second;
+        }
+        out << "}}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+inline void write_csv(const std::string& path, const std::vector<result>& results) {
+    std::ofstream out(path);
+    out << std::setprecision(10)
+        << "name,family,impl,type,n,iterations,min_ns,median_ns,mean_ns,p99_ns,stddev_ns,ns_per_item,vs_std,counters\n";
+    for (const result& r : results) {
+        out << r.def->name() << "," << r.def->family << "," << r.def->impl << ","
+            << r.def->type << "," << r.def->n << "," << r.iterations << ","
+            << r.minNs << "," << r.medianNs << "," << r.meanNs << "," << r.p99Ns << ","
+            << r.stddevNs << "," << r.nsPerItem() << "," << r.vsStd << ",";
+        for (size_t c = 0; c < r.counters.size(); c++) {
+            out << (c ? ";" : "") << r.counters[c].first << "=" << r.counters[c].second;
+        }
+        out << "\n";
+    }
+}
+
+//////////////////////////////////////////////////////
+// Entry point
+//////////////////////////////////////////////////////
+
+inline int run(int argc, char** argv) {
+    options opts = parse_args(argc, argv);
+
+    perf_counters perf;
+    if (opts.perf && !perf.available()) {
+        std::cerr << "perf counters unavailable (perf_event_open failed - no PMU, or"
+                     " kernel.perf_event_paranoid too strict); reporting timings only\n";
+    }
+    perf_counters* perfPtr = opts.perf && perf.available() ? &perf : nullptr;
+
+    std::vector<result> results;
+    print_header();
+    for (const case_def& def : registry()) {
+        if (!opts.filter.empty() && def.name().find(opts.filter) == std::string::npos) {
+            continue;
+        }
+        results.push_back(run_case(def, opts, perfPtr));
+
+        // compare against the std baseline, if it ran first
+        result& r = results.back();
+        for (const result& other : results) {
+            const case_def& o = *other.def;
+            if (o.impl == "std" && def.impl != "std" && o.family == def.family &&
+                o.type == def.type && o.n == def.n && other.medianNs > 0) {
+                r.vsStd = r.medianNs / other.medianNs;
+            }
+        }
+        print_result(r);
+    }
+
+    if (!opts.jsonPath.empty()) {
+        write_json(opts.jsonPath, results);
+    }
+    if (!opts.csvPath.empty()) {
+        write_csv(opts.csvPath, results);
+    }
+    return 0;
+}
+
+}; // end of 'bench'
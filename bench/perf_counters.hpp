@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+//
+// Hardware performance counters for the bench harness, read through Linux
+// perf_event_open.
+//
+// Each event is opened on its own (not as a group), so one the PMU or kernel
+// doesn't support just drops out, rather than taking the rest with it. If
+// none can be opened - not Linux, no PMU (e.g. most VMs/containers), or
+// kernel.perf_event_paranoid too strict - available() is false and the
+// harness carries on with timings only.
+//
+// Counters are opened with `inherit`, so cases that spawn threads count their
+// work too. Counts are scaled up when the kernel had to multiplex events.
+//
+namespace bench {
+
+class perf_counters {
+public:
+    struct reading {
+        const char* name;
+        double value;
+    };
+
+private:
+    struct Event {
+        const char* name;
+        uint32_t type;
+        uint64_t config;
+        int fd;
+    };
+
+    std::vector<Event> events;
+
+public:
+    perf_counters() {
+#ifdef __linux__
+        auto cache = [](uint64_t id, uint64_t op, uint64_t result) {
+            return id | (op << 8) | (result << 16);
+        };
+
+        std::vector<Event> wanted = {
+            {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1},
+            {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, -1},
+            {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, -1},
+            {"l1d_misses", PERF_TYPE_HW_CACHE,
+                cache(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS), -1},
+            {"llc_misses", PERF_TYPE_HW_CACHE,
+                cache(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS), -1},
+            {"dtlb_misses", PERF_TYPE_HW_CACHE,
+                cache(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS), -1},
+        };
+
+        for (Event& e : wanted) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = e.type;
+            attr.config = e.config;
+            attr.disabled = 1;
+            attr.inherit = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            e.fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            if (e.fd >= 0) {
+                events.push_back(e);
+            }
+        }
+#endif
+    }
+
+    ~perf_counters() {
+#ifdef __linux__
+        for (Event& e : events) {
+            close(e.fd);
+        }
+#endif
+    }
+
+    perf_counters(const perf_counters&) = delete;
+    perf_counters& operator=(const perf_counters&) = delete;
+
+    bool available() const {
+        return !events.empty();
+    }
+
+    // Zeroes and starts every counter.
+    void start() {
+#ifdef __linux__
+        for (Event& e : events) {
+            ioctl(e.fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(e.fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    // Stops counting (e.g. around untimed setup) - resume() picks up where it left off.
+    void pause() {
+#ifdef __linux__
+        for (Event& e : events) {
+            ioctl(e.fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+#endif
+    }
+
+    void resume() {
+#ifdef __linux__
+        for (Event& e : events) {
+            ioctl(e.fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    // Counts since start(), scaled for multiplexing.
+    std::vector<reading> read() const {
+        std::vector<reading> out;
+#ifdef __linux__
+        for (const Event& e : events) {
+            uint64_t buf[3] = {0, 0, 0}; // value, time enabled, time running
+            if (::read(e.fd, buf, sizeof(buf)) != sizeof(buf)) {
+                continue;
+            }
+            double value = static_cast<double>(buf[0]);
+            if (buf[2] > 0 && buf[2] < buf[1]) {
+                value *= static_cast<double>(buf[1]) / buf[2];
+            }
+            out.push_back({e.name, value});
+        }
+#endif
+        return out;
+    }
+};
+
+}; // end of 'bench'
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "harness.hpp"
+
+//
+// Element types for parameter sweeps, and a way to make a value of each.
+//
+
+// Trivially copyable, one cache line.
+struct Payload64 {
+    uint64_t words[8];
+};
+
+namespace bench {
+
+template <> inline const char* type_name<Payload64>() { return "payload64"; }
+
+template <class T>
+inline T make_value(uint64_t i) {
+    return static_cast<T>(i);
+}
+
+template <>
+inline std::string make_value<std::string>(uint64_t i) {
+    return "value-" + std::to_string(i) + "-with-heap-storage"; // past the SSO limit
+}
+
+template <>
+inline Payload64 make_value<Payload64>(uint64_t i) {
+    Payload64 p;
+    for (uint64_t& w : p.words) {
+        w = i;
+    }
+    return p;
+}
+
+}; // end of 'bench'
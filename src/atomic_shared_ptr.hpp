@@ -0,0 +1,192 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+
+#include "shared_ptr.hpp"
+
+namespace rack {
+
+template <class T>
+class atomic_shared_ptr {
+private:
+
+    //
+    // Lock-free shared_ptr slot, using split reference counts.
+    //
+    // The slot is a single 64-bit word holding:
+    //      - the control block pointer (low 48 bits) AND;
+    //      - a 'local' count of readers currently borrowing it (high 16 bits).
+    //
+    // A reader first bumps the local count with one fetch_add. This pins the
+    // control block, because a writer can't drop the slot's reference without
+    // accounting for borrowers. The reader then takes a proper strong
+    // reference and hands its borrow back, either:
+    //      - by decrementing the local count (control block still installed) OR;
+    //      - by decrementing the strong count (a writer swapped the block out,
+    //        and moved all outstanding borrows onto the strong count as it did).
+    //
+    // Borrows are interchangeable, so it doesn't matter whose borrow gets
+    // handed back to which count, only that the totals match.
+    //
+    // Readers never block and never take a lock. Writers are a single
+    // exchange/CAS on the slot.
+    //
+    using ControlBlock = typename shared_ptr<T>::SharedPtrControlBlock;
+
+    static constexpr uint32_t PTR_BITS = 48;
+    static constexpr uint64_t PTR_MASK = (uint64_t(1) << PTR_BITS) - 1;
+    static constexpr uint64_t ONE_BORROW = uint64_t(1) << PTR_BITS;
+
+    mutable std::atomic<uint64_t> slot;
+
+public:
+
+    //////////////////////////////////////////////////////
+    // Constructors
+    //////////////////////////////////////////////////////
+
+    atomic_shared_ptr()
+        : slot(0) {}
+
+    atomic_shared_ptr(shared_ptr<T> desired)
+        : slot(pack(detach(desired))) {}
+
+    // Not safe to destroy while other threads are still accessing the slot.
+    ~atomic_shared_ptr() {
+        uint64_t cur = slot.load(std::memory_order_acquire);
+        assert(borrowCount(cur) == 0);
+        adopt(blockOf(cur)); // drops the slot's own reference
+    }
+
+    atomic_shared_ptr(const atomic_shared_ptr&) = delete;
+    atomic_shared_ptr& operator=(const atomic_shared_ptr&) = delete;
+
+    //////////////////////////////////////////////////////
+    // Atomic operations
+    //////////////////////////////////////////////////////
+
+    shared_ptr<T> load() const {
+        // borrow the current control block
+        uint64_t cur = slot.fetch_add(ONE_BORROW, std::memory_order_acquire);
+        ControlBlock* cb = blockOf(cur);
+
+        // take our own strong reference - safe, as the borrow keeps `cb` alive
+        if (cb) {
+            cb->strongCnt.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // hand the borrow back
+        cur += ONE_BORROW;
+        while (true) {
+            if (blockOf(cur) == cb && borrowCount(cur) > 0) {
+                if (slot.compare_exchange_weak(cur, cur - ONE_BORROW,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed)) {
+                    break;
+                }
+            } else {
+                // `cb` was swapped out and our borrow moved onto its strong count.
+                // Can't reach zero here - we hold our own reference.
+                if (cb) {
+                    cb->strongCnt.fetch_sub(1, std::memory_order_relaxed);
+                }
+                break;
+            }
+        }
+
+        return adopt(cb);
+    }
+
+    void store(shared_ptr<T> desired) {
+        exchange(std::move(desired));
+    }
+
+    // Installs `desired`, returning the previously installed pointer.
+    shared_ptr<T> exchange(shared_ptr<T> desired) {
+        uint64_t old = slot.exchange(pack(detach(desired)), std::memory_order_acq_rel);
+        return takeOver(old);
+    }
+
+    //
+    // If the slot holds the same control block as `expected`, installs `desired`
+    // and returns true. Otherwise, loads the current value into `expected` and
+    // returns false.
+    //
+    bool compare_exchange_strong(shared_ptr<T>& expected, shared_ptr<T> desired) {
+        ControlBlock* desiredCb = desired.controlBlock;
+        uint64_t cur = slot.load(std::memory_order_acquire);
+
+        // retry while only the borrow count is changing under us
+        while (blockOf(cur) == expected.controlBlock) {
+            if (slot.compare_exchange_weak(cur, pack(desiredCb),
+                                           std::memory_order_acq_rel,
+                                           std::memory_order_acquire)) {
+                detach(desired);  // reference now owned by the slot
+                takeOver(cur);    // drops the slot's old reference
+                return true;
+            }
+        }
+
+        expected = load();
+        return false;
+    }
+
+    bool compare_exchange_weak(shared_ptr<T>& expected, shared_ptr<T> desired) {
+        return compare_exchange_strong(expected, std::move(desired));
+    }
+
+    bool is_lock_free() const {
+        return slot.is_lock_free();
+    }
+
+private:
+
+    static ControlBlock* blockOf(uint64_t v) {
+        return reinterpret_cast<ControlBlock*>(v & PTR_MASK);
+    }
+
+    static uint32_t borrowCount(uint64_t v) {
+        return static_cast<uint32_t>(v >> PTR_BITS);
+    }
+
+    static uint64_t pack(ControlBlock* cb) {
+        uint64_t v = reinterpret_cast<uintptr_t>(cb);
+        assert((v & ~PTR_MASK) == 0 && "control block address doesn't fit in 48 bits");
+        return v;
+    }
+
+    // Steals the reference held by `sp`, leaving it null.
+    static ControlBlock* detach(shared_ptr<T>& sp) {
+        ControlBlock* cb = sp.controlBlock;
+        sp.ptr = nullptr;
+        sp.controlBlock = nullptr;
+        return cb;
+    }
+
+    // Wraps an already-counted reference to `cb` in a shared_ptr.
+    static shared_ptr<T> adopt(ControlBlock* cb) {
+        shared_ptr<T> sp;
+        if (cb) {
+            sp.ptr = cb->ptr;
+            sp.controlBlock = cb;
+        }
+        return sp;
+    }
+
+    //
+    // Takes over the slot's reference from a value just swapped out of it,
+    // moving any outstanding borrows onto the strong count.
+    //
+    static shared_ptr<T> takeOver(uint64_t old) {
+        ControlBlock* cb = blockOf(old);
+        uint32_t borrows = borrowCount(old);
+        if (cb && borrows > 0) {
+            cb->strongCnt.fetch_add(borrows, std::memory_order_relaxed);
+        }
+        return adopt(cb);
+    }
+};
+
+}; // end of 'rack'
@@ -0,0 +1,610 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__) || defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+#include "vector.hpp"
+
+namespace rack {
+
+namespace detail {
+
+//
+// Word-wise bulk operations, `dst[i] = op(dst[i], src[i])`. Done 4 words at a
+// time with AVX2, or 2 with SSE2 (always there on x86-64), then one at a time
+// for the rest.
+//
+struct bits_and {
+    static uint64_t word(uint64_t a, uint64_t b) { return a & b; }
+#ifdef __SSE2__
+    static __m128i simd(__m128i a, __m128i b) { return _mm_and_si128(a, b); }
+#endif
+#ifdef __AVX2__
+    static __m256i simd(__m256i a, __m256i b) { return _mm256_and_si256(a, b); }
+#endif
+};
+
+struct bits_or {
+    static uint64_t word(uint64_t a, uint64_t b) { return a | b; }
+#ifdef __SSE2__
+    static __m128i simd(__m128i a, __m128i b) { return _mm_or_si128(a, b); }
+#endif
+#ifdef __AVX2__
+    static __m256i simd(__m256i a, __m256i b) { return _mm256_or_si256(a, b); }
+#endif
+};
+
+struct bits_xor {
+    static uint64_t word(uint64_t a, uint64_t b) { return a ^ b; }
+#ifdef __SSE2__
+    static __m128i simd(__m128i a, __m128i b) { return _mm_xor_si128(a, b); }
+#endif
+#ifdef __AVX2__
+    static __m256i simd(__m256i a, __m256i b) { return _mm256_xor_si256(a, b); }
+#endif
+};
+
+// a & ~b (note the intrinsics negate their *first* operand)
+struct bits_andnot {
+    static uint64_t word(uint64_t a, uint64_t b) { return a & ~b; }
+#ifdef __SSE2__
+    static __m128i simd(__m128i a, __m128i b) { return _mm_andnot_si128(b, a); }
+#endif
+#ifdef __AVX2__
+    static __m256i simd(__m256i a, __m256i b) { return _mm256_andnot_si256(b, a); }
+#endif
+};
+
+template <class Op>
+void bulkApply(uint64_t* dst, const uint64_t* src, size_t n) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 4 <= n; i += 4) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), Op::simd(a, b));
+    }
+#elif defined(__SSE2__)
+    for (; i + 2 <= n; i += 2) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), Op::simd(a, b));
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] = Op::word(dst[i], src[i]);
+    }
+}
+
+//
+// Set bits in a word - one POPCNT instruction when built with -mpopcnt (e.g.
+// via the RACK_NATIVE CMake option). Otherwise __builtin_popcountll is a libgcc
+// call, so count in-register with the SWAR bit-twiddling sequence instead.
+//
+inline uint32_t popcount(uint64_t w) {
+#ifdef __POPCNT__
+    return static_cast<uint32_t>(__builtin_popcountll(w));
+#else
+    w = w - ((w >> 1) & 0x5555555555555555ULL);
+    w = (w & 0x3333333333333333ULL) + ((w >> 2) & 0x3333333333333333ULL);
+    w = (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return static_cast<uint32_t>((w * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+// Position of the `k`th (0-based) set bit of `w`, which has more than `k` set bits.
+inline uint32_t selectInWord(uint64_t w, uint32_t k) {
+#ifdef __BMI2__
+    return __builtin_ctzll(_pdep_u64(uint64_t(1) << k, w));
+#else
+    //
+    // Broadword - per-byte set bit counts, then their running totals (byte b
+    // holds the count for bytes 0..b). The bytes whose total is <= k precede
+    // the one holding the kth bit, and are counted with a byte-wise compare.
+    //
+    const uint64_t ONES = 0x0101010101010101ULL;
+    const uint64_t HIGHS = 0x8080808080808080ULL;
+    uint64_t s = w - ((w >> 1) & 0x5555555555555555ULL);
+    s = (s & 0x3333333333333333ULL) + ((s >> 2) & 0x3333333333333333ULL);
+    s = (s + (s >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    uint64_t totals = s * ONES;
+
+    uint64_t le = (((k * ONES) | HIGHS) - totals) & HIGHS;
+    uint32_t byteIdx = static_cast<uint32_t>(((le >> 7) * ONES) >> 56);
+    uint32_t shift = byteIdx * 8;
+    k -= static_cast<uint32_t>(((totals << 8) >> shift) & 0xff);
+
+    // then clear the low set bits of that byte
+    uint64_t byte = (w >> shift) & 0xff;
+    for (; k > 0; k--) {
+        byte &= byte - 1;
+    }
+    return shift + __builtin_ctzll(byte);
+#endif
+}
+
+}; // end of 'detail'
+
+//
+// Bit-packed vector of bools - 64 per uint64_t word, an eighth of the memory of
+// a vector<uint8_t> of flags. Bits past size() in the last word are kept zero,
+// so whole-word operations (count, bulk and/or/xor, set bit iteration) never
+// need masking.
+//
+// rank(i) (set bits before i) and select(k) (position of the kth set bit) run
+// in constant and logarithmic time off an index built by build_rank_select().
+// The index is a sampled prefix count - a 64 bit total every 64Ki bits and a
+// 16 bit count (relative to that) every 512 bits, ~3% on top of the bits. Any
+// modification drops it.
+//
+class bitvector {
+public:
+    static constexpr size_t WORD_BITS = 64;
+
+private:
+    static constexpr size_t BLOCK_BITS = 512;          // 8 words
+    static constexpr size_t SUPER_BITS = 1 << 16;      // 128 blocks
+    static constexpr size_t BLOCK_WORDS = BLOCK_BITS / WORD_BITS;
+    static constexpr size_t BLOCKS_PER_SUPER = SUPER_BITS / BLOCK_BITS;
+
+    vector<uint64_t> words;
+    size_t _size;
+
+    // rank/select index
+    vector<uint64_t> superRanks;    // set bits before each superblock
+    vector<uint16_t> blockRanks;    // set bits before each block, from its superblock
+    bool indexed;
+
+    static size_t wordsFor(size_t bits) {
+        return (bits + WORD_BITS - 1) / WORD_BITS;
+    }
+
+    // Words holding `bits` bits, as a (uint32_t-sized) word vector length.
+    static uint32_t wordCount(size_t bits) {
+        size_t n = wordsFor(bits);
+        if (n > UINT32_MAX) {
+            throw std::length_error("bitvector too large: bits=" + std::to_string(bits));
+        }
+        return static_cast<uint32_t>(n);
+    }
+
+    static uint64_t bit(size_t i) {
+        return uint64_t(1) << (i % WORD_BITS);
+    }
+
+public:
+
+    //////////////////////////////////////////////////////
+    // Construtors
+    //////////////////////////////////////////////////////
+
+    bitvector()
+        : _size(0), indexed(false) {}
+
+    // `n` bits, all `val`
+    explicit bitvector(size_t n, bool val = false)
+        : _size(0), indexed(false) {
+        resize(n, val);
+    }
+
+    void swap(bitvector& other) noexcept {
+        words.swap(other.words);
+        std::swap(_size, other._size);
+        superRanks.swap(other.superRanks);
+        blockRanks.swap(other.blockRanks);
+        std::swap(indexed, other.indexed);
+    }
+
+    //////////////////////////////////////////////////////
+    // Accessors
+    //////////////////////////////////////////////////////
+
+    // Bit `i` (unchecked)
+    bool operator [](size_t i) const {
+        return (words.data()[i / WORD_BITS] & bit(i)) != 0;
+    }
+
+    // Bit `i`, with bounds checking
+    bool test(size_t i) const {
+        checkIndex(i);
+        return (*this)[i];
+    }
+
+    // Underlying words - bit i is bit (i % 64) of word i / 64
+    const uint64_t* data() const {
+        return words.data();
+    }
+
+    size_t num_words() const {
+        return words.size();
+    }
+
+    //////////////////////////////////////////////////////
+    // Modifiers
+    //////////////////////////////////////////////////////
+
+    void set(size_t i) {
+        checkIndex(i);
+        words.data()[i / WORD_BITS] |= bit(i);
+        indexed = false;
+    }
+
+    void set(size_t i, bool val) {
+        if (val) {
+            set(i);
+        } else {
+            reset(i);
+        }
+    }
+
+    void reset(size_t i) {
+        checkIndex(i);
+        words.data()[i / WORD_BITS] &= ~bit(i);
+        indexed = false;
+    }
+
+    void flip(size_t i) {
+        checkIndex(i);
+        words.data()[i / WORD_BITS] ^= bit(i);
+        indexed = false;
+    }
+
+    void push_back(bool val) {
+        if (_size % WORD_BITS == 0) {
+            words.push_back(0);
+        }
+        if (val) {
+            words.data()[_size / WORD_BITS] |= bit(_size);
+        }
+        _size++;
+        indexed = false;
+    }
+
+    // Sets every bit to `val`
+    void fill(bool val) {
+        std::fill(words.data(), words.data() + words.size(), val ? ~uint64_t(0) : 0);
+        clearTail();
+        indexed = false;
+    }
+
+    // Flips every bit
+    void flip() {
+        uint64_t* w = words.data();
+        for (size_t i = 0; i < words.size(); i++) {
+            w[i] = ~w[i];
+        }
+        clearTail();
+        indexed = false;
+    }
+
+    //
+    // Resizes to `n` bits. If growing, the new bits are `val`.
+    //
+    void resize(size_t n, bool val = false) {
+        size_t oldSize = _size;
+        words.resize(wordCount(n));
+        _size = n;
+
+        if (n > oldSize && val) {
+            uint64_t* w = words.data();
+            // rest of the old last word, then whole words
+            size_t i = oldSize;
+            for (; i < n && i % WORD_BITS != 0; i++) {
+                w[i / WORD_BITS] |= bit(i);
+            }
+            if (i % WORD_BITS == 0) {
+                std::fill(w + i / WORD_BITS, w + words.size(), ~uint64_t(0));
+            }
+        }
+        clearTail();
+        indexed = false;
+    }
+
+    void clear() {
+        words.clear();
+        _size = 0;
+        indexed = false;
+    }
+
+    void reserve(size_t n) {
+        words.reserve(wordCount(n));
+    }
+
+    //////////////////////////////////////////////////////
+    // Bulk operations
+    //////////////////////////////////////////////////////
+
+    // Both operands must be the same size.
+
+    bitvector& operator&=(const bitvector& other) {
+        return bulk<detail::bits_and>(other);
+    }
+
+    bitvector& operator|=(const bitvector& other) {
+        return bulk<detail::bits_or>(other);
+    }
+
+    bitvector& operator^=(const bitvector& other) {
+        return bulk<detail::bits_xor>(other);
+    }
+
+    // Clears the bits set in `other` (this &= ~other)
+    bitvector& and_not(const bitvector& other) {
+        return bulk<detail::bits_andnot>(other);
+    }
+
+    friend bitvector operator&(bitvector a, const bitvector& b) { return a &= b; }
+    friend bitvector operator|(bitvector a, const bitvector& b) { return a |= b; }
+    friend bitvector operator^(bitvector a, const bitvector& b) { return a ^= b; }
+
+    bool operator==(const bitvector& other) const {
+        return _size == other._size
+            && std::equal(words.data(), words.data() + words.size(), other.words.data());
+    }
+
+    bool operator!=(const bitvector& other) const {
+        return !(*this == other);
+    }
+
+    //////////////////////////////////////////////////////
+    // Counting
+    //////////////////////////////////////////////////////
+
+    // Number of set bits
+    size_t count() const {
+        const uint64_t* w = words.data();
+        size_t total = 0;
+        for (size_t i = 0; i < words.size(); i++) {
+            total += detail::popcount(w[i]);
+        }
+        return total;
+    }
+
+    bool any() const {
+        const uint64_t* w = words.data();
+        return std::any_of(w, w + words.size(), [](uint64_t x) { return x != 0; });
+    }
+
+    bool none() const {
+        return !any();
+    }
+
+    //////////////////////////////////////////////////////
+    // Rank/select
+    //////////////////////////////////////////////////////
+
+    // (Re)builds the rank/select index. O(n / 64).
+    void build_rank_select() {
+        size_t numBlocks = _size / BLOCK_BITS + 1;
+        superRanks.clear();
+        blockRanks.clear();
+        superRanks.reserve(static_cast<uint32_t>(_size / SUPER_BITS + 1));
+        blockRanks.reserve(static_cast<uint32_t>(numBlocks));
+
+        const uint64_t* w = words.data();
+        uint64_t total = 0;
+        uint64_t superStart = 0;
+        for (size_t b = 0; b < numBlocks; b++) {
+            if (b % BLOCKS_PER_SUPER == 0) {
+                superRanks.push_back(total);
+                superStart = total;
+            }
+            blockRanks.push_back(static_cast<uint16_t>(total - superStart));
+
+            size_t end = std::min((b + 1) * BLOCK_WORDS, size_t(words.size()));
+            for (size_t i = b * BLOCK_WORDS; i < end; i++) {
+                total += detail::popcount(w[i]);
+            }
+        }
+        indexed = true;
+    }
+
+    bool has_rank_select() const {
+        return indexed;
+    }
+
+    // Set bits in [0, i), for i <= size(). Needs the index.
+    size_t rank(size_t i) const {
+        checkIndexed();
+        if (i > _size) {
+            throwOutOfBounds(i);
+        }
+        const uint64_t* w = words.data();
+        size_t r = superRanks.data()[i / SUPER_BITS] + blockRanks.data()[i / BLOCK_BITS];
+        size_t word = i / WORD_BITS;
+        for (size_t j = i / BLOCK_BITS * BLOCK_WORDS; j < word; j++) {
+            r += detail::popcount(w[j]);
+        }
+        if (i % WORD_BITS != 0) {
+            r += detail::popcount(w[word] & (bit(i) - 1));
+        }
+        return r;
+    }
+
+    // Unset bits in [0, i)
+    size_t rank0(size_t i) const {
+        return i - rank(i);
+    }
+
+    //
+    // Position of the `k`th (0-based) set bit, or size() if there are k or
+    // fewer. Needs the index.
+    //
+    size_t select(size_t k) const {
+        checkIndexed();
+
+        // last superblock, then block, starting at or before the kth set bit
+        const uint64_t* supers = superRanks.data();
+        size_t s = std::upper_bound(supers, supers + superRanks.size(), k) - supers - 1;
+        k -= supers[s];
+
+        const uint16_t* blocks = blockRanks.data();
+        size_t first = s * BLOCKS_PER_SUPER;
+        size_t last = std::min(first + BLOCKS_PER_SUPER, size_t(blockRanks.size()));
+        size_t b = std::upper_bound(blocks + first, blocks + last, k) - blocks - 1;
+        k -= blocks[b];
+
+        // then word by word
+        const uint64_t* w = words.data();
+        for (size_t i = b * BLOCK_WORDS; i < words.size(); i++) {
+            uint32_t c = detail::popcount(w[i]);
+            if (k < c) {
+                return i * WORD_BITS + detail::selectInWord(w[i], static_cast<uint32_t>(k));
+            }
+            k -= c;
+        }
+        return _size;
+    }
+
+    //////////////////////////////////////////////////////
+    // Set bit iteration
+    //////////////////////////////////////////////////////
+
+    //
+    // Visits the positions of the set bits, in order - zero words are skipped
+    // whole, and each set bit costs a ctz and a clear.
+    //
+    template <class Fn>
+    void for_each_set(Fn fn) const {
+        const uint64_t* w = words.data();
+        for (size_t i = 0; i < words.size(); i++) {
+            uint64_t word = w[i];
+            while (word != 0) {
+                fn(i * WORD_BITS + __builtin_ctzll(word));
+                word &= word - 1;
+            }
+        }
+    }
+
+    // Forward iterator over the positions of the set bits
+    class set_bit_iterator {
+    private:
+        const uint64_t* words;
+        size_t numWords;
+        size_t wordIdx;
+        uint64_t cur;    // unvisited bits of words[wordIdx]
+
+        void skipEmpty() {
+            while (cur == 0 && ++wordIdx < numWords) {
+                cur = words[wordIdx];
+            }
+        }
+
+    public:
+        set_bit_iterator(const uint64_t* w, size_t n, size_t start)
+            : words(w), numWords(n), wordIdx(start), cur(start < n ? w[start] : 0) {
+            if (start < n) {
+                skipEmpty();
+            }
+        }
+
+        size_t operator*() const {
+            return wordIdx * WORD_BITS + __builtin_ctzll(cur);
+        }
+
+        set_bit_iterator& operator++() {
+            cur &= cur - 1;
+            skipEmpty();
+            return *this;
+        }
+
+        bool operator==(const set_bit_iterator& other) const {
+            return wordIdx == other.wordIdx && cur == other.cur;
+        }
+
+        bool operator!=(const set_bit_iterator& other) const {
+            return !(*this == other);
+        }
+    };
+
+    struct set_bit_range {
+        set_bit_iterator first, last;
+        set_bit_iterator begin() const { return first; }
+        set_bit_iterator end() const { return last; }
+    };
+
+    // for (size_t i : bv.set_bits()) ...
+    set_bit_range set_bits() const {
+        return set_bit_range{set_bit_iterator(words.data(), words.size(), 0),
+                             set_bit_iterator(words.data(), words.size(), words.size())};
+    }
+
+    //////////////////////////////////////////////////////
+    // Capacity
+    //////////////////////////////////////////////////////
+
+    bool empty() const {
+        return _size == 0;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    //////////////////////////////////////////////////////
+    // Display
+    //////////////////////////////////////////////////////
+
+    // Bits as '0'/'1' characters, index 0 first
+    std::string to_string() const {
+        std::string s;
+        s.reserve(_size);
+        for (size_t i = 0; i < _size; i++) {
+            s.push_back((*this)[i] ? '1' : '0');
+        }
+        return s;
+    }
+
+private:
+
+    template <class Op>
+    bitvector& bulk(const bitvector& other) {
+        if (other._size != _size) {
+            throw std::runtime_error(
+                "Size mismatch error: " +
+                std::string("size=") + std::to_string(_size) + ", other=" + std::to_string(other._size)
+            );
+        }
+        detail::bulkApply<Op>(words.data(), other.words.data(), words.size());
+        indexed = false;
+        return *this;
+    }
+
+    // Zeroes the bits past size() in the last word
+    void clearTail() {
+        if (_size % WORD_BITS != 0) {
+            words.data()[words.size() - 1] &= bit(_size) - 1;
+        }
+    }
+
+    void checkIndex(size_t i) const {
+        if (i >= _size) {
+            throwOutOfBounds(i);
+        }
+    }
+
+    void throwOutOfBounds(size_t i) const {
+        throw std::runtime_error(
+            "Index out of bounds error: " +
+            std::string("index=") + std::to_string(i) + ", size=" + std::to_string(_size)
+        );
+    }
+
+    void checkIndexed() const {
+        if (!indexed) {
+            throw std::runtime_error("Rank/select index not built: call build_rank_select()");
+        }
+    }
+};
+
+}; // end of 'rack'
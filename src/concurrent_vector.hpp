@@ -0,0 +1,283 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "instrument.hpp"
+
+namespace rack {
+
+//
+// Append-only vector that many threads can push_back to at once, whose elements
+// never move.
+//
+// Like deque, storage is a table of separately allocated segments - but here
+// segment `s` holds FIRST_SEGMENT << s elements, so each new segment doubles
+// the capacity, and an index maps to its segment with a couple of bit tricks.
+// The table is a fixed array of MAX_SEGMENTS pointers, enough for any index,
+// so it never has to be regrown or copied either.
+//
+// Appends are lock-free:
+//      - a fetch_add on the size claims an index (grow_by claims a range);
+//      - the first thread to need a segment allocates it and installs it with a
+//        CAS (losers free theirs) AND;
+//      - the element is constructed in place, then marked published.
+//
+// Reads are wait-free. An index returned by push_back()/grow_by() can be read
+// by the thread that pushed it (or any thread it hands the index to). Other
+// threads check is_published(i) / try_get(i) first - size() counts claimed
+// indices, some of which may still be under construction.
+//
+// NOTE: References to elements stay valid until the vector is destroyed or
+//       cleared (clear() must not race with anything else).
+//
+template <class T>
+class concurrent_vector {
+public:
+    static constexpr uint32_t FIRST_SEGMENT_BITS = 5;
+    static constexpr size_t FIRST_SEGMENT = size_t(1) << FIRST_SEGMENT_BITS;
+    static constexpr uint32_t MAX_SEGMENTS = 64 - FIRST_SEGMENT_BITS;
+
+private:
+
+    //
+    // A segment is one allocation - `n` element slots, then `n` one byte
+    // published flags.
+    //
+    std::atomic<T*> segments[MAX_SEGMENTS];
+    std::atomic<size_t> _size;
+
+    static size_t segmentLength(uint32_t s) {
+        return FIRST_SEGMENT << s;
+    }
+
+    static size_t segmentBytes(uint32_t s) {
+        return segmentLength(s) * (sizeof(T) + 1);
+    }
+
+    //
+    // Index `i` lives in segment floor(log2(i + FIRST_SEGMENT)) - FIRST_SEGMENT_BITS,
+    // at the offset given by the bits below that.
+    //
+    static uint32_t segmentOf(size_t i, size_t& offset) {
+        uint64_t j = static_cast<uint64_t>(i) + FIRST_SEGMENT;
+        uint32_t bit = 63 - __builtin_clzll(j);
+        offset = static_cast<size_t>(j ^ (uint64_t(1) << bit));
+        return bit - FIRST_SEGMENT_BITS;
+    }
+
+    static std::atomic<uint8_t>* flagsOf(T* segment, uint32_t s) {
+        return reinterpret_cast<std::atomic<uint8_t>*>(segment + segmentLength(s));
+    }
+
+public:
+
+    //////////////////////////////////////////////////////
+    // Construtors
+    //////////////////////////////////////////////////////
+
+    concurrent_vector()
+        : _size(0) {
+        for (auto& s : segments) {
+            s.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~concurrent_vector() {
+        clear();
+    }
+
+    concurrent_vector(const concurrent_vector&) = delete;
+    concurrent_vector& operator=(const concurrent_vector&) = delete;
+
+    //////////////////////////////////////////////////////
+    // Appending (lock-free)
+    //////////////////////////////////////////////////////
+
+    // Appends a copy of `val`. Returns its index.
+    size_t push_back(const T& val) {
+        return emplace_back(val);
+    }
+
+    size_t push_back(T&& val) {
+        return emplace_back(std::move(val));
+    }
+
+    template <class... Args>
+    size_t emplace_back(Args&&... args) {
+        size_t i = _size.fetch_add(1, std::memory_order_relaxed);
+        size_t offset;
+        uint32_t s = segmentOf(i, offset);
+        T* segment = ensureSegment(s);
+
+        new (segment + offset) T(std::forward<Args>(args)...);
+        flagsOf(segment, s)[offset].store(1, std::memory_order_release);
+        return i;
+    }
+
+    //
+    // Appends `n` copies of `val` at consecutive indices. Returns the first.
+    // (The range may span several segments.)
+    //
+    size_t grow_by(size_t n, const T& val = T()) {
+        size_t first = _size.fetch_add(n, std::memory_order_relaxed);
+        size_t i = first;
+        size_t end = first + n;
+        while (i < end) {
+            size_t offset;
+            uint32_t s = segmentOf(i, offset);
+            T* segment = ensureSegment(s);
+            std::atomic<uint8_t>* flags = flagsOf(segment, s);
+
+            // the part of the range in this segment
+            size_t count = std::min(end - i, segmentLength(s) - offset);
+            for (size_t k = offset; k < offset + count; k++) {
+                new (segment + k) T(val);
+                flags[k].store(1, std::memory_order_release);
+            }
+            i += count;
+        }
+        return first;
+    }
+
+    //////////////////////////////////////////////////////
+    // Reading (wait-free)
+    //////////////////////////////////////////////////////
+
+    //
+    // Element `i`, which must be published - e.g. an index this thread pushed,
+    // or one is_published() has confirmed.
+    //
+    T& operator[](size_t i) {
+        size_t offset;
+        uint32_t s = segmentOf(i, offset);
+        return segments[s].load(std::memory_order_acquire)[offset];
+    }
+
+    const T& operator[](size_t i) const {
+        return const_cast<concurrent_vector&>(*this)[i];
+    }
+
+    // Element `i`, with bounds and publication checked
+    T& at(size_t i) {
+        T* p = try_get(i);
+        if (p == nullptr) {
+            throw std::runtime_error(
+                "Index out of bounds or unpublished: " +
+                std::string("index=") + std::to_string(i) + ", size=" + std::to_string(size())
+            );
+        }
+        return *p;
+    }
+
+    // Whether element `i` has been fully constructed (acquire - its contents are visible).
+    bool is_published(size_t i) const {
+        return const_cast<concurrent_vector*>(this)->try_get(i) != nullptr;
+    }
+
+    // Element `i` if published, otherwise nullptr.
+    T* try_get(size_t i) {
+        if (i >= _size.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        size_t offset;
+        uint32_t s = segmentOf(i, offset);
+        T* segment = segments[s].load(std::memory_order_acquire);
+        if (segment == nullptr || flagsOf(segment, s)[offset].load(std::memory_order_acquire) == 0) {
+            return nullptr;
+        }
+        return segment + offset;
+    }
+
+    //////////////////////////////////////////////////////
+    // Capacity
+    //////////////////////////////////////////////////////
+
+    // Indices claimed so far (the most recent may not be published yet).
+    size_t size() const {
+        return _size.load(std::memory_order_acquire);
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    // Elements the allocated segments hold.
+    size_t capacity() const {
+        size_t cap = 0;
+        for (uint32_t s = 0; s < MAX_SEGMENTS; s++) {
+            if (segments[s].load(std::memory_order_acquire)) {
+                cap += segmentLength(s);
+            }
+        }
+        return cap;
+    }
+
+    // Allocates segments up to `n` elements ahead of time (safe alongside appends).
+    void reserve(size_t n) {
+        if (n == 0) {
+            return;
+        }
+        size_t offset;
+        uint32_t last = segmentOf(n - 1, offset);
+        for (uint32_t s = 0; s <= last; s++) {
+            ensureSegment(s);
+        }
+    }
+
+    //
+    // Destroys every element and frees all segments. Not safe alongside any
+    // other operation.
+    //
+    void clear() {
+        for (uint32_t s = 0; s < MAX_SEGMENTS; s++) {
+            T* segment = segments[s].load(std::memory_order_acquire);
+            if (segment == nullptr) {
+                continue;
+            }
+            std::atomic<uint8_t>* flags = flagsOf(segment, s);
+            for (size_t k = 0; k < segmentLength(s); k++) {
+                if (flags[k].load(std::memory_order_relaxed)) {
+                    segment[k].~T();
+                }
+            }
+            instrument::freed<concurrent_vector>("concurrent_vector", segmentBytes(s));
+            ::operator delete(segment);
+            segments[s].store(nullptr, std::memory_order_relaxed);
+        }
+        _size.store(0, std::memory_order_relaxed);
+    }
+
+private:
+
+    // Segment `s`, allocating and installing it if no thread has yet.
+    T* ensureSegment(uint32_t s) {
+        T* segment = segments[s].load(std::memory_order_acquire);
+        if (segment != nullptr) {
+            return segment;
+        }
+
+        static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__, "over-aligned T unsupported");
+        T* fresh = static_cast<T*>(::operator new(segmentBytes(s)));
+        std::atomic<uint8_t>* flags = flagsOf(fresh, s);
+        for (size_t k = 0; k < segmentLength(s); k++) {
+            new (&flags[k]) std::atomic<uint8_t>(0);
+        }
+
+        if (segments[s].compare_exchange_strong(segment, fresh, std::memory_order_acq_rel,
+                                                                std::memory_order_acquire)) {
+            instrument::allocated<concurrent_vector>("concurrent_vector", segmentBytes(s));
+            return fresh;
+        }
+        ::operator delete(fresh); // another thread won
+        return segment;
+    }
+};
+
+}; // end of 'rack'
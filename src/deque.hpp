@@ -1,4 +1,13 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
 #include <memory>
+#include <sstream>
+#include <string>
+#include <type_traits>
+
+#include "instrument.hpp"
 
 #define PAGE_SIZE 4096
 
@@ -47,8 +56,8 @@ public:
         chunkSize = chunkSizeBytes / sizeof(T);
         _size = 0;
 
-        chunkMap = chunkAllocator.allocate(nChunks);
-        chunkMap[0] = elementAllocator.allocate(chunkSize);
+        chunkMap = allocateMap(nChunks);
+        chunkMap[0] = allocateChunk();
 
         frontChunk = 0;
         frontOff = chunkSize / 2;
@@ -58,9 +67,18 @@ public:
     }
 
     ~deque() {
-
+        clear();
+        for (uint32_t i = 0; i < nChunks; i++) {
+            if (chunkMap[i] != nullptr) {
+                freeChunk(chunkMap[i]);
+            }
+        }
+        freeMap(chunkMap, nChunks);
     }
 
+    deque(const deque&) = delete;
+    deque& operator=(const deque&) = delete;
+
     //////////////////////////////////////////////////////
     // Accessors
     //////////////////////////////////////////////////////
@@ -73,6 +91,22 @@ public:
         return chunkMap[backChunk][backOff];
     }
 
+    //
+    // Calls `fn(const T* first, uint32_t count)` for each contiguous run of
+    // elements (i.e. the used part of each chunk), front to back.
+    //
+    template <class Fn>
+    void for_each_segment(Fn fn) const {
+        if (_size == 0) {
+            return;
+        }
+        for (uint32_t c = frontChunk; c <= backChunk; c++) {
+            uint32_t first = c == frontChunk ? frontOff : 0;
+            uint32_t last = c == backChunk ? backOff : chunkSize - 1;
+            fn(static_cast<const T*>(chunkMap[c] + first), last - first + 1);
+        }
+    }
+
     //////////////////////////////////////////////////////
     // Modifiers
     //////////////////////////////////////////////////////
@@ -80,7 +114,7 @@ public:
     void push_front(const T& val) {
         // front is at limit => resize needed
         if (frontChunk == 0 && frontOff == 0) {
-            grow();
+            grow(true);
         }
 
         //
@@ -94,7 +128,7 @@ public:
 
                 // lazily allocate new chunk (if needed)
                 if (chunkMap[frontChunk] == nullptr) {
-                    chunkMap[frontChunk] = elementAllocator.allocate(chunkSize);
+                    chunkMap[frontChunk] = allocateChunk();
                 }
             } else {
                 frontOff -= 1;
@@ -109,7 +143,7 @@ public:
     void push_back(const T& val) {
         // back is at limit => resize needed
         if (backChunk == nChunks - 1 && backOff == chunkSize - 1) {
-            grow();
+            grow(false);
         }
 
         //
@@ -123,7 +157,7 @@ public:
 
                 // lazily allocate new chunk (if needed)
                 if (chunkMap[backChunk] == nullptr) {
-                    chunkMap[backChunk] = elementAllocator.allocate(chunkSize);
+                    chunkMap[backChunk] = allocateChunk();
                 }
             } else {
                 backOff += 1;
@@ -152,7 +186,7 @@ public:
 
         // move the front pointer
         if (frontOff == chunkSize - 1) {
-            frontChunk -= 1;
+            frontChunk += 1;
             frontOff = 0;
         } else {
             frontOff += 1;
@@ -183,9 +217,60 @@ public:
         }
     }
 
+    //
+    // Appends `n` elements at the back that `fill(T* dst, uint32_t count)`
+    // writes in place, one call per contiguous run of chunk space - e.g.
+    // straight from a read(2). Only for trivially copyable T. Runs filled
+    // before a throw from `fill` stay appended.
+    //
+    template <class Fn>
+    void append_uninitialized(uint32_t n, Fn fill) {
+        static_assert(std::is_trivially_copyable<T>::value, "append_uninitialized needs a trivially copyable T");
+        if (n > UINT32_MAX - _size) {
+            throw std::runtime_error(
+                "Size overflow error: " +
+                std::string("size=") + std::to_string(_size) + ", n=" + std::to_string(n)
+            );
+        }
+        while (n > 0) {
+            // back is at limit => resize needed
+            if (_size > 0 && backChunk == nChunks - 1 && backOff == chunkSize - 1) {
+                grow(false);
+            }
+
+            // first free slot (the back pointer itself, if empty)
+            uint32_t chunk = backChunk;
+            uint32_t off = backOff;
+            if (_size > 0) {
+                if (backOff == chunkSize - 1) {
+                    chunk += 1;
+                    off = 0;
+                } else {
+                    off += 1;
+                }
+            }
+            if (chunkMap[chunk] == nullptr) {
+                chunkMap[chunk] = allocateChunk();
+            }
+
+            uint32_t count = std::min(n, chunkSize - off);
+            fill(chunkMap[chunk] + off, count);
+
+            backChunk = chunk;
+            backOff = off + count - 1;
+            _size += count;
+            n -= count;
+        }
+    }
+
     void resize();
 
-    void clear();
+    // Destroys every element. Chunks stay allocated.
+    void clear() {
+        while (_size > 0) {
+            pop_back();
+        }
+    }
 
     //////////////////////////////////////////////////////
     // Display
@@ -229,20 +314,27 @@ public:
     // Capacity
     //////////////////////////////////////////////////////
 
-    bool empty() { return _size == 0; }
-    uint32_t size() { return _size; }
+    bool empty() const { return _size == 0; }
+    uint32_t size() const { return _size; }
 
 private:
+    //
     // Grow the chunk map by 2x. Re-centre the existing pointers.
-    void grow() {
+    //
+    // When the new room can't be split evenly (growing from 1 chunk), the spare
+    // chunk goes to the end that ran out - the front if `atFront`.
+    //
+    void grow(bool atFront) {
         // allocate new 2x map
         uint32_t newnChunks = nChunks * 2;
-        T** newChunkMap = chunkAllocator.allocate(newnChunks);
+        T** newChunkMap = allocateMap(newnChunks);
+        instrument::map_regrown<deque>("deque");
 
         // copy chunk pointers to center of the map
-        uint32_t centerOff = newnChunks / 4;
+        uint32_t spare = newnChunks - nChunks;
+        uint32_t centerOff = atFront ? spare - spare / 2 : spare / 2;
         for (int i = 0; i < newnChunks; i++) {
-            if (i >= centerOff && i < newnChunks - centerOff) {
+            if (i >= centerOff && i < centerOff + nChunks) {
                 newChunkMap[i] = chunkMap[i - centerOff];
             } else {
                 newChunkMap[i] = nullptr;
@@ -250,7 +342,7 @@ private:
         }
 
         // de-allocate old map and replace with new one
-        chunkAllocator.deallocate(chunkMap, nChunks);
+        freeMap(chunkMap, nChunks);
         chunkMap = newChunkMap;
         nChunks = newnChunks;
 
@@ -258,6 +350,26 @@ private:
         frontChunk += centerOff;
         backChunk += centerOff;
     }
+
+    T* allocateChunk() {
+        instrument::allocated<deque>("deque", sizeof(T) * chunkSize);
+        return elementAllocator.allocate(chunkSize);
+    }
+
+    void freeChunk(T* chunk) {
+        instrument::freed<deque>("deque", sizeof(T) * chunkSize);
+        elementAllocator.deallocate(chunk, chunkSize);
+    }
+
+    T** allocateMap(uint32_t n) {
+        instrument::allocated<deque>("deque", sizeof(T*) * n);
+        return chunkAllocator.allocate(n);
+    }
+
+    void freeMap(T** map, uint32_t n) {
+        instrument::freed<deque>("deque", sizeof(T*) * n);
+        chunkAllocator.deallocate(map, n);
+    }
 };
 
 };
\ No newline at end of file
@@ -0,0 +1,349 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "refcount.hpp"
+
+namespace rack {
+
+//
+// Epoch-based memory reclamation, for lock-free structures whose readers may
+// still hold a pointer to a node after a writer has unlinked it.
+//
+// Readers wrap each access in an epoch::guard. Writers unlink a node, then
+// epoch::retire() it rather than deleting it. A node retired in epoch `e` is
+// freed once the global epoch reaches e + 2 - by then, every guard that was
+// open when it was unlinked has closed.
+//
+// The global epoch only advances when every thread inside a guard has seen the
+// current epoch. Retired nodes are kept per thread in three 'limbo' buckets
+// (one per epoch mod 3), and freed in batches: every RETIRE_BATCH retirements
+// a thread tries to advance the epoch and frees whatever has become safe.
+//
+// Threads register automatically on first use and unregister at exit. On
+// unregistering, anything a thread still had in limbo moves to a shared
+// orphan list, which later collect() calls free. Whatever is left there at
+// process exit (including the main thread's limbo) is freed then - by which
+// point no other thread may still be using the epoch.
+//
+class epoch {
+public:
+
+    // Retirements between attempts to advance the epoch and free limbo.
+    static constexpr uint32_t RETIRE_BATCH = 64;
+
+    //////////////////////////////////////////////////////
+    // Guard
+    //////////////////////////////////////////////////////
+
+    // Pins the current epoch for the guard's lifetime. Guards may nest.
+    class guard {
+    public:
+        guard() { epoch::enter(); }
+        ~guard() { epoch::exit(); }
+
+        guard(const guard&) = delete;
+        guard& operator=(const guard&) = delete;
+    };
+
+private:
+
+    struct Retired {
+        void* ptr;
+        void (*deleter)(void*);
+        uint64_t epoch;
+    };
+
+    // localEpoch layout - (epoch << 1) | ACTIVE
+    static constexpr uint64_t ACTIVE = 1;
+
+    struct alignas(64) ThreadRecord {
+        std::atomic<uint64_t> localEpoch{0};
+        std::atomic<bool> inUse{true};
+        std::atomic<size_t> pending{0}; // owner-only writes; read by pending()
+        uint32_t nesting = 0;
+        uint32_t sinceCollect = 0;
+        std::vector<Retired> limbo[3];
+        ThreadRecord* next = nullptr;
+    };
+
+    struct Handle {
+        ThreadRecord* rec = nullptr;
+        ~Handle() { epoch::unregister_thread(); }
+    };
+
+    static inline std::atomic<uint64_t> globalEpoch{2};
+    static inline std::atomic<ThreadRecord*> records{nullptr};
+
+    static inline std::mutex orphanLock;
+    static inline std::vector<Retired> orphans;
+    static inline std::atomic<size_t> orphanCount{0};
+
+    //
+    // Frees the orphan list at process exit. The main thread's Handle (a
+    // thread_local) is destroyed before statics, so its limbo is in there too.
+    // Defined after `orphans`, so it's destroyed first.
+    //
+    struct Reaper {
+        ~Reaper() { epoch::freeOrphans(UINT64_MAX); }
+    };
+    static inline Reaper reaper;
+
+    static Handle& handle() {
+        thread_local Handle h;
+        return h;
+    }
+
+public:
+
+    //////////////////////////////////////////////////////
+    // Registration
+    //////////////////////////////////////////////////////
+
+    // Claims a thread record for the calling thread (done automatically on first use).
+    static void register_thread() {
+        Handle& h = handle();
+        if (h.rec) {
+            return;
+        }
+
+        // reuse a record a finished thread has released
+        for (ThreadRecord* r = records.load(std::memory_order_acquire); r; r = r->next) {
+            bool free = false;
+            if (!r->inUse.load(std::memory_order_relaxed) &&
+                r->inUse.compare_exchange_strong(free, true, std::memory_order_acquire)) {
+                h.rec = r;
+                return;
+            }
+        }
+
+        // none free - push a new one
+        ThreadRecord* r = new ThreadRecord();
+        ThreadRecord* head = records.load(std::memory_order_relaxed);
+        do {
+            r->next = head;
+        } while (!records.compare_exchange_weak(head, r, std::memory_order_release,
+                                                         std::memory_order_relaxed));
+        h.rec = r;
+    }
+
+    //
+    // Releases the calling thread's record, handing anything still in its limbo
+    // to the orphan list. Must be called outside any guard.
+    //
+    static void unregister_thread() {
+        Handle& h = handle();
+        ThreadRecord* r = h.rec;
+        if (!r) {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lk(orphanLock);
+            for (auto& bucket : r->limbo) {
+                orphans.insert(orphans.end(), bucket.begin(), bucket.end());
+                orphanCount.fetch_add(bucket.size(), std::memory_order_relaxed);
+                bucket.clear();
+            }
+        }
+        r->pending.store(0, std::memory_order_relaxed);
+        r->sinceCollect = 0;
+        r->localEpoch.store(0, std::memory_order_release);
+        r->inUse.store(false, std::memory_order_release);
+        h.rec = nullptr;
+    }
+
+    //////////////////////////////////////////////////////
+    // Critical sections
+    //////////////////////////////////////////////////////
+
+    static void enter() {
+        ThreadRecord* r = local();
+        if (r->nesting++ > 0) {
+            return;
+        }
+
+        // publish the epoch we're reading under, re-checking it didn't move meanwhile
+        uint64_t e = globalEpoch.load(std::memory_order_relaxed);
+        while (true) {
+            r->localEpoch.store((e << 1) | ACTIVE, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            uint64_t now = globalEpoch.load(std::memory_order_relaxed);
+            if (now == e) {
+                break;
+            }
+            e = now;
+        }
+    }
+
+    static void exit() {
+        ThreadRecord* r = local();
+        if (--r->nesting > 0) {
+            return;
+        }
+        r->localEpoch.store(r->localEpoch.load(std::memory_order_relaxed) & ~ACTIVE,
+                            std::memory_order_release);
+    }
+
+    //////////////////////////////////////////////////////
+    // Retirement
+    //////////////////////////////////////////////////////
+
+    // Defers `deleter(ptr)` until no guard can still be reading `ptr`.
+    static void retire(void* ptr, void (*deleter)(void*)) {
+        ThreadRecord* r = local();
+        uint64_t e = globalEpoch.load(std::memory_order_acquire);
+
+        std::vector<Retired>& bucket = r->limbo[e % 3];
+        if (!bucket.empty() && bucket.front().epoch + 2 <= e) {
+            freeBucket(r, bucket); // left over from epoch e - 3 - safe
+        }
+        bucket.push_back({ptr, deleter, e});
+        r->pending.store(r->pending.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+        if (++r->sinceCollect >= RETIRE_BATCH) {
+            r->sinceCollect = 0;
+            collect();
+        }
+    }
+
+    template <class T>
+    static void retire(T* ptr) {
+        retire(ptr, [](void* p) { delete static_cast<T*>(p); });
+    }
+
+    //
+    // Tries to advance the global epoch, then frees whatever the calling thread
+    // (and the orphan list) holds that is now safe.
+    //
+    static void collect() {
+        tryAdvance();
+        uint64_t e = globalEpoch.load(std::memory_order_acquire);
+
+        ThreadRecord* r = local();
+        for (auto& bucket : r->limbo) {
+            if (!bucket.empty() && bucket.front().epoch + 2 <= e) {
+                freeBucket(r, bucket);
+            }
+        }
+
+        if (orphanCount.load(std::memory_order_relaxed) > 0) {
+            freeOrphans(e);
+        }
+    }
+
+    //
+    // Blocks until everything the calling thread (and the orphan list) has
+    // retired so far is freed. Must be called outside any guard.
+    //
+    static void synchronize() {
+        uint64_t target = globalEpoch.load(std::memory_order_acquire) + 2;
+        while (globalEpoch.load(std::memory_order_acquire) < target) {
+            if (!tryAdvance()) {
+                std::this_thread::yield();
+            }
+        }
+        collect();
+    }
+
+    //////////////////////////////////////////////////////
+    // Observers
+    //////////////////////////////////////////////////////
+
+    static uint64_t current() {
+        return globalEpoch.load(std::memory_order_relaxed);
+    }
+
+    // Retired but not yet freed, across all threads (approximate under concurrency).
+    static size_t pending() {
+        size_t n = orphanCount.load(std::memory_order_relaxed);
+        for (ThreadRecord* r = records.load(std::memory_order_acquire); r; r = r->next) {
+            n += r->pending.load(std::memory_order_relaxed);
+        }
+        return n;
+    }
+
+private:
+
+    static ThreadRecord* local() {
+        Handle& h = handle();
+        if (!h.rec) {
+            register_thread();
+        }
+        return h.rec;
+    }
+
+    // Advances the global epoch if every active thread has seen it.
+    static bool tryAdvance() {
+        uint64_t e = globalEpoch.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        for (ThreadRecord* r = records.load(std::memory_order_acquire); r; r = r->next) {
+            uint64_t l = r->localEpoch.load(std::memory_order_acquire);
+            if ((l & ACTIVE) && (l >> 1) != e) {
+                return false;
+            }
+        }
+        return globalEpoch.compare_exchange_strong(e, e + 1, std::memory_order_acq_rel);
+    }
+
+    static void freeBucket(ThreadRecord* r, std::vector<Retired>& bucket) {
+        // swap out first - a deleter may itself retire
+        std::vector<Retired> items;
+        items.swap(bucket);
+        r->pending.store(r->pending.load(std::memory_order_relaxed) - items.size(),
+                         std::memory_order_relaxed);
+
+        for (Retired& item : items) {
+            item.deleter(item.ptr);
+        }
+
+        // hand the buffer back to avoid re-growing it
+        if (bucket.empty()) {
+            items.clear();
+            bucket.swap(items);
+        }
+    }
+
+    static void freeOrphans(uint64_t e) {
+        std::vector<Retired> safe;
+        {
+            std::lock_guard<std::mutex> lk(orphanLock);
+            auto it = std::partition(orphans.begin(), orphans.end(),
+                                     [e](const Retired& item) { return item.epoch + 2 > e; });
+            safe.assign(it, orphans.end());
+            orphans.erase(it, orphans.end());
+            orphanCount.fetch_sub(safe.size(), std::memory_order_relaxed);
+        }
+        for (Retired& item : safe) {
+            item.deleter(item.ptr);
+        }
+    }
+};
+
+//
+// atomic_refcount whose control blocks are retired through rack::epoch rather
+// than deleted. Only freeing the block is deferred - the managed object is
+// still destroyed as soon as the last shared_ptr drops it (destroyBlock). So a
+// reader inside an epoch::guard may still read the counts of a block it found
+// through a raw pointer, but not the object it pointed to.
+//
+// Usage: rack::shared_ptr<T, rack::epoch_refcount>
+//
+class epoch_refcount : public atomic_refcount {
+public:
+    explicit epoch_refcount(void (*)(epoch_refcount*))
+        : atomic_refcount(nullptr) {}
+
+    template <class Block>
+    static void reclaim(Block* cb) {
+        epoch::retire(cb);
+    }
+};
+
+}; // end of 'rack'
@@ -0,0 +1,589 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace rack {
+
+//
+// Open-addressing hash map, in the style of a 'Swiss table'.
+//
+// Elements live inline in one flat array of slots. Alongside it, each slot has
+// a one byte 'control' entry:
+//      - EMPTY - never used since the last rehash;
+//      - DELETED - a tombstone left by erase() AND;
+//      - 0..127 - full, holding the low 7 bits of the element's hash (H2).
+//
+// Control bytes are grouped 16 at a time, so a lookup compares a whole group
+// against H2 in a couple of SSE2 instructions, and only touches the slots
+// whose byte matched. The rest of the hash (H1) picks the first group, and
+// groups are probed quadratically from there until one holding an EMPTY.
+//
+// The table grows (2x) once 7/8 of it is full or tombstoned. If it's mostly
+// tombstones, it is instead rebuilt at the same size to clear them out.
+//
+// NOTE: Elements are std::pair<K, V> (not pair<const K, V>), so they can be
+//       moved on rehash - don't modify a key through an iterator.
+//
+// NOTE: Any insert may rehash, which invalidates iterators and references.
+//
+template <class K, class V, class Hash = std::hash<K>, class KeyEqual = std::equal_to<K>>
+class flat_hash_map {
+public:
+    using key_type = K;
+    using mapped_type = V;
+    using value_type = std::pair<K, V>;
+
+private:
+    static constexpr size_t GROUP_WIDTH = 16;
+    static constexpr size_t NPOS = static_cast<size_t>(-1);
+
+    static constexpr int8_t EMPTY = -128;
+    static constexpr int8_t DELETED = -2;
+
+    struct alignas(GROUP_WIDTH) Group {
+        int8_t ctrl[GROUP_WIDTH];
+    };
+
+    Group* groups;
+    value_type* slots;
+    size_t nGroups;
+    size_t _size;
+    size_t growthLeft; // inserts into EMPTY slots left before a rehash
+
+    Hash hasher;
+    KeyEqual keyEqual;
+
+    std::allocator<Group> groupAllocator;
+    std::allocator<value_type> slotAllocator;
+    using slotTraits = std::allocator_traits<std::allocator<value_type>>;
+
+public:
+
+    //////////////////////////////////////////////////////
+    // Construtors
+    //////////////////////////////////////////////////////
+
+    flat_hash_map()
+        : groups(nullptr), slots(nullptr), nGroups(0), _size(0), growthLeft(0) {
+        // do nothing - allocation occurs on first insert
+    }
+
+    // With a given (e.g. seeded) hasher and key comparison
+    explicit flat_hash_map(const Hash& hash, const KeyEqual& equal = KeyEqual())
+        : groups(nullptr), slots(nullptr), nGroups(0), _size(0), growthLeft(0),
+          hasher(hash), keyEqual(equal) {}
+
+    ~flat_hash_map() {
+        destroyAll();
+        freeTable(groups, slots, nGroups);
+    }
+
+    flat_hash_map(const flat_hash_map& other)
+        : flat_hash_map(other.hasher, other.keyEqual) {
+        reserve(other._size);
+        for (const value_type& v : other) {
+            insert(v);
+        }
+    }
+
+    flat_hash_map(flat_hash_map&& other) noexcept
+        : groups(other.groups), slots(other.slots), nGroups(other.nGroups),
+          _size(other._size), growthLeft(other.growthLeft),
+          hasher(std::move(other.hasher)), keyEqual(std::move(other.keyEqual)) {
+        other.groups = nullptr;
+        other.slots = nullptr;
+        other.nGroups = 0;
+        other._size = 0;
+        other.growthLeft = 0;
+    }
+
+    flat_hash_map& operator=(const flat_hash_map& other) {
+        if (this != &other) {
+            flat_hash_map tmp(other);
+            swap(tmp);
+        }
+        return *this;
+    }
+
+    flat_hash_map& operator=(flat_hash_map&& other) noexcept {
+        if (this != &other) {
+            flat_hash_map tmp(std::move(other));
+            swap(tmp);
+        }
+        return *this;
+    }
+
+    void swap(flat_hash_map& other) noexcept {
+        std::swap(groups, other.groups);
+        std::swap(slots, other.slots);
+        std::swap(nGroups, other.nGroups);
+        std::swap(_size, other._size);
+        std::swap(growthLeft, other.growthLeft);
+        std::swap(hasher, other.hasher);
+        std::swap(keyEqual, other.keyEqual);
+    }
+
+    //////////////////////////////////////////////////////
+    // Iterators
+    //////////////////////////////////////////////////////
+
+    template <bool Const>
+    class Iterator {
+    private:
+        using Value = typename std::conditional<Const, const std::pair<K, V>, std::pair<K, V>>::type;
+
+        const int8_t* ctrl;
+        const int8_t* ctrlEnd;
+        Value* slot;
+
+        friend class flat_hash_map;
+
+        // skip forward to the next full slot (or the end)
+        void settle() {
+            while (ctrl != ctrlEnd && *ctrl < 0) {
+                ++ctrl;
+                ++slot;
+            }
+        }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = std::pair<K, V>;
+        using pointer           = Value*;
+        using reference         = Value&;
+
+        Iterator() : ctrl(nullptr), ctrlEnd(nullptr), slot(nullptr) {}
+        Iterator(const int8_t* c, const int8_t* e, Value* s) : ctrl(c), ctrlEnd(e), slot(s) {}
+
+        // iterator -> const_iterator
+        template <bool C = Const, class = typename std::enable_if<C>::type>
+        Iterator(const Iterator<false>& other)
+            : ctrl(other.ctrl), ctrlEnd(other.ctrlEnd), slot(other.slot) {}
+
+        Value& operator*() const { return *slot; }
+        Value* operator->() const { return slot; }
+
+        bool operator==(const Iterator& other) const { return ctrl == other.ctrl; }
+        bool operator!=(const Iterator& other) const { return ctrl != other.ctrl; }
+
+        Iterator& operator++() { ++ctrl; ++slot; settle(); return *this; }
+        Iterator operator++(int) { Iterator tmp = *this; ++(*this); return tmp; }
+
+        template <bool> friend class Iterator;
+    };
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    iterator begin() { return iteratorAt(0, true); }
+    iterator end() { return iteratorAt(capacity(), false); }
+    const_iterator begin() const { return const_cast<flat_hash_map*>(this)->begin(); }
+    const_iterator end() const { return const_cast<flat_hash_map*>(this)->end(); }
+
+    //////////////////////////////////////////////////////
+    // Lookup
+    //////////////////////////////////////////////////////
+
+    iterator find(const K& key) {
+        size_t i = findIndex(key, hashOf(key));
+        return i == NPOS ? end() : iteratorAt(i, false);
+    }
+
+    const_iterator find(const K& key) const {
+        return const_cast<flat_hash_map*>(this)->find(key);
+    }
+
+    Hash hash_function() const {
+        return hasher;
+    }
+
+    KeyEqual key_eq() const {
+        return keyEqual;
+    }
+
+    bool contains(const K& key) const {
+        return findIndex(key, hashOf(key)) != NPOS;
+    }
+
+    size_t count(const K& key) const {
+        return contains(key) ? 1 : 0;
+    }
+
+    V& at(const K& key) {
+        size_t i = findIndex(key, hashOf(key));
+        if (i == NPOS) {
+            throw std::runtime_error("Key not found");
+        }
+        return slots[i].second;
+    }
+
+    const V& at(const K& key) const {
+        return const_cast<flat_hash_map*>(this)->at(key);
+    }
+
+    // Value for `key`, default-inserted if absent
+    V& operator[](const K& key) {
+        return try_emplace(key).first->second;
+    }
+
+    V& operator[](K&& key) {
+        return try_emplace(std::move(key)).first->second;
+    }
+
+    //////////////////////////////////////////////////////
+    // Modifiers
+    //////////////////////////////////////////////////////
+
+    //
+    // Inserts `val` if its key is absent. Returns the element with that key, and
+    // whether it was inserted.
+    //
+    std::pair<iterator, bool> insert(const value_type& val) {
+        return emplaceKey(val.first, val.second);
+    }
+
+    std::pair<iterator, bool> insert(value_type&& val) {
+        return emplaceKey(std::move(val.first), std::move(val.second));
+    }
+
+    // Constructs the value from `args` only if `key` is absent.
+    template <class... Args>
+    std::pair<iterator, bool> try_emplace(const K& key, Args&&... args) {
+        return emplaceKey(key, std::forward<Args>(args)...);
+    }
+
+    template <class... Args>
+    std::pair<iterator, bool> try_emplace(K&& key, Args&&... args) {
+        return emplaceKey(std::move(key), std::forward<Args>(args)...);
+    }
+
+    template <class... Args>
+    std::pair<iterator, bool> emplace(Args&&... args) {
+        return insert(value_type(std::forward<Args>(args)...));
+    }
+
+    // Inserts or overwrites
+    template <class M>
+    std::pair<iterator, bool> insert_or_assign(const K& key, M&& val) {
+        auto res = emplaceKey(key, std::forward<M>(val));
+        if (!res.second) {
+            res.first->second = std::forward<M>(val);
+        }
+        return res;
+    }
+
+    // Erases the element with `key`, if any. Returns the number erased.
+    size_t erase(const K& key) {
+        size_t i = findIndex(key, hashOf(key));
+        if (i == NPOS) {
+            return 0;
+        }
+        eraseAt(i);
+        return 1;
+    }
+
+    // Erases the element at `pos`. Returns an iterator to the one after it.
+    iterator erase(const_iterator pos) {
+        size_t i = pos.slot - slots;
+        eraseAt(i);
+        return iteratorAt(i, true);
+    }
+
+    // Destroys every element. Capacity is kept.
+    void clear() {
+        destroyAll();
+        if (nGroups > 0) {
+            std::memset(groups, EMPTY, nGroups * sizeof(Group));
+        }
+        _size = 0;
+        growthLeft = maxLoad(capacity());
+    }
+
+    //////////////////////////////////////////////////////
+    // Capacity
+    //////////////////////////////////////////////////////
+
+    bool empty() const { return _size == 0; }
+    size_t size() const { return _size; }
+    size_t capacity() const { return nGroups * GROUP_WIDTH; }
+
+    float load_factor() const {
+        return capacity() == 0 ? 0.0f : static_cast<float>(_size) / capacity();
+    }
+
+    float max_load_factor() const {
+        return 0.875f;
+    }
+
+    // Makes room for `n` elements without further rehashing.
+    void reserve(size_t n) {
+        if (n > _size + growthLeft) {
+            rehashTo(capacityFor(n));
+        }
+    }
+
+    //
+    // Rebuilds the table with room for at least `n` slots (and the current
+    // elements), clearing out tombstones. rehash(0) shrinks to fit.
+    //
+    void rehash(size_t n) {
+        size_t cap = capacityFor(_size);
+        while (cap < n) {
+            cap *= 2;
+        }
+        if (_size == 0 && n == 0) {
+            cap = 0;
+        }
+        rehashTo(cap);
+    }
+
+private:
+
+    //////////////////////////////////////////////////////
+    // Control groups
+    //////////////////////////////////////////////////////
+
+    //
+    // Group matches - bit `i` is set if control byte `i` of `g` matched.
+    //
+
+    static uint32_t matchByte(const Group& g, int8_t b) {
+#ifdef __SSE2__
+        __m128i ctrl = _mm_load_si128(reinterpret_cast<const __m128i*>(g.ctrl));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(b))));
+#else
+        uint32_t mask = 0;
+        for (uint32_t i = 0; i < GROUP_WIDTH; i++) {
+            mask |= static_cast<uint32_t>(g.ctrl[i] == b) << i;
+        }
+        return mask;
+#endif
+    }
+
+    // EMPTY or DELETED - i.e. the sign bit is set
+    static uint32_t matchFree(const Group& g) {
+#ifdef __SSE2__
+        __m128i ctrl = _mm_load_si128(reinterpret_cast<const __m128i*>(g.ctrl));
+        return static_cast<uint32_t>(_mm_movemask_epi8(ctrl));
+#else
+        uint32_t mask = 0;
+        for (uint32_t i = 0; i < GROUP_WIDTH; i++) {
+            mask |= static_cast<uint32_t>(g.ctrl[i] < 0) << i;
+        }
+        return mask;
+#endif
+    }
+
+    int8_t& ctrlAt(size_t i) {
+        return groups[i / GROUP_WIDTH].ctrl[i % GROUP_WIDTH];
+    }
+
+    //////////////////////////////////////////////////////
+    // Hashing and probing
+    //////////////////////////////////////////////////////
+
+    // std::hash is often the identity - mix it, so both H1 and H2 are usable.
+    size_t hashOf(const K& key) const {
+        uint64_t h = static_cast<uint64_t>(hasher(key)) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(h ^ (h >> 32));
+    }
+
+    static size_t h1(size_t hash) { return hash >> 7; }
+    static int8_t h2(size_t hash) { return static_cast<int8_t>(hash & 0x7F); }
+
+    //
+    // Probe sequence - groups h1, h1 + 1, h1 + 3, h1 + 6, ... (mod nGroups).
+    // With a power of two nGroups, this visits every group.
+    //
+
+    size_t findIndex(const K& key, size_t hash) const {
+        if (nGroups == 0) {
+            return NPOS;
+        }
+        size_t mask = nGroups - 1;
+        size_t g = h1(hash) & mask;
+        for (size_t step = 1; ; step++) {
+            for (uint32_t m = matchByte(groups[g], h2(hash)); m != 0; m &= m - 1) {
+                size_t i = g * GROUP_WIDTH + __builtin_ctz(m);
+                if (keyEqual(slots[i].first, key)) {
+                    return i;
+                }
+            }
+            // an EMPTY slot ends the probe - `key` would have gone here
+            if (matchByte(groups[g], EMPTY) != 0) {
+                return NPOS;
+            }
+            g = (g + step) & mask;
+        }
+    }
+
+    // First EMPTY or DELETED slot on `hash`'s probe sequence.
+    size_t findFree(size_t hash) const {
+        size_t mask = nGroups - 1;
+        size_t g = h1(hash) & mask;
+        for (size_t step = 1; ; step++) {
+            uint32_t m = matchFree(groups[g]);
+            if (m != 0) {
+                return g * GROUP_WIDTH + __builtin_ctz(m);
+            }
+            g = (g + step) & mask;
+        }
+    }
+
+    //////////////////////////////////////////////////////
+    // Insertion and erasure
+    //////////////////////////////////////////////////////
+
+    template <class KK, class... Args>
+    std::pair<iterator, bool> emplaceKey(KK&& key, Args&&... args) {
+        size_t hash = hashOf(key);
+        size_t i = findIndex(key, hash);
+        if (i != NPOS) {
+            return {iteratorAt(i, false), false};
+        }
+
+        // reusing a tombstone doesn't cost any growth
+        i = nGroups == 0 ? NPOS : findFree(hash);
+        if (i == NPOS || (growthLeft == 0 && ctrlAt(i) != DELETED)) {
+            //
+            // `key` or `args` may refer into this table (e.g. m[m.begin()->first]),
+            // which the rehash moves and frees - so build the element first.
+            //
+            value_type staged(std::piecewise_construct,
+                              std::forward_as_tuple(std::forward<KK>(key)),
+                              std::forward_as_tuple(std::forward<Args>(args)...));
+            rehashForInsert();
+            return {placeAt(findFree(hash), hash, std::move(staged)), true};
+        }
+
+        return {placeAt(i, hash, std::piecewise_construct,
+                        std::forward_as_tuple(std::forward<KK>(key)),
+                        std::forward_as_tuple(std::forward<Args>(args)...)), true};
+    }
+
+    // Constructs an element (with `hash`) from `args` in free slot `i`.
+    template <class... Args>
+    iterator placeAt(size_t i, size_t hash, Args&&... args) {
+        slotTraits::construct(slotAllocator, slots + i, std::forward<Args>(args)...);
+        if (ctrlAt(i) == EMPTY) {
+            growthLeft--;
+        }
+        ctrlAt(i) = h2(hash);
+        _size++;
+        return iteratorAt(i, false);
+    }
+
+    void eraseAt(size_t i) {
+        slotTraits::destroy(slotAllocator, slots + i);
+        _size--;
+
+        //
+        // If the slot's group still has an EMPTY, every probe through the group
+        // already stops here - so the slot can go straight back to EMPTY, rather
+        // than leaving a tombstone.
+        //
+        if (matchByte(groups[i / GROUP_WIDTH], EMPTY) != 0) {
+            ctrlAt(i) = EMPTY;
+            growthLeft++;
+        } else {
+            ctrlAt(i) = DELETED;
+        }
+    }
+
+    //////////////////////////////////////////////////////
+    // Rehashing
+    //////////////////////////////////////////////////////
+
+    // Most slots an n-slot table fills before rehashing (7/8 of it).
+    static size_t maxLoad(size_t cap) {
+        return cap - cap / 8;
+    }
+
+    // Smallest (power of two) capacity holding `n` elements.
+    static size_t capacityFor(size_t n) {
+        size_t cap = GROUP_WIDTH;
+        while (maxLoad(cap) < n) {
+            cap *= 2;
+        }
+        return cap;
+    }
+
+    // Out of growth - clear tombstones if that frees enough room, otherwise grow.
+    void rehashForInsert() {
+        if (nGroups > 0 && _size < maxLoad(capacity()) / 2) {
+            rehashTo(capacity());
+        } else {
+            rehashTo(capacity() == 0 ? GROUP_WIDTH : capacity() * 2);
+        }
+    }
+
+    // Moves every element into a fresh table of `cap` slots (0 or a power of two).
+    void rehashTo(size_t cap) {
+        Group* oldGroups = groups;
+        value_type* oldSlots = slots;
+        size_t oldnGroups = nGroups;
+
+        nGroups = cap / GROUP_WIDTH;
+        groups = nullptr;
+        slots = nullptr;
+        if (nGroups > 0) {
+            groups = groupAllocator.allocate(nGroups);
+            slots = slotAllocator.allocate(cap);
+            std::memset(groups, EMPTY, nGroups * sizeof(Group));
+        }
+
+        for (size_t i = 0; i < oldnGroups * GROUP_WIDTH; i++) {
+            if (oldGroups[i / GROUP_WIDTH].ctrl[i % GROUP_WIDTH] < 0) {
+                continue;
+            }
+            size_t hash = hashOf(oldSlots[i].first);
+            size_t j = findFree(hash);
+            slotTraits::construct(slotAllocator, slots + j, std::move(oldSlots[i]));
+            slotTraits::destroy(slotAllocator, oldSlots + i);
+            ctrlAt(j) = h2(hash);
+        }
+        growthLeft = maxLoad(cap) - _size;
+
+        freeTable(oldGroups, oldSlots, oldnGroups);
+    }
+
+    void destroyAll() {
+        for (size_t i = 0; i < capacity(); i++) {
+            if (ctrlAt(i) >= 0) {
+                slotTraits::destroy(slotAllocator, slots + i);
+            }
+        }
+    }
+
+    void freeTable(Group* g, value_type* s, size_t n) {
+        if (n > 0) {
+            groupAllocator.deallocate(g, n);
+            slotAllocator.deallocate(s, n * GROUP_WIDTH);
+        }
+    }
+
+    // Iterator at slot `i` - moved on to the next full slot if `settle`.
+    iterator iteratorAt(size_t i, bool settle) {
+        const int8_t* ctrl = groups ? groups[0].ctrl + i : nullptr;
+        const int8_t* ctrlEnd = groups ? groups[0].ctrl + capacity() : nullptr;
+        iterator it(ctrl, ctrlEnd, slots + i);
+        if (settle) {
+            it.settle();
+        }
+        return it;
+    }
+};
+
+}; // end of 'rack'
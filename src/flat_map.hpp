@@ -0,0 +1,516 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <stdexcept>
+#include <utility>
+
+#include "vector.hpp"
+
+namespace rack {
+
+//////////////////////////////////////////////////////
+// Search policies
+//////////////////////////////////////////////////////
+
+//
+// How flat_map/flat_set find a key in their sorted key array. Each policy has
+// an `index<K, Compare>` the container keeps alongside its keys:
+//      - rebuild() is called after every modification AND;
+//      - lower_bound() returns the position of the first key not less than `key`.
+//
+
+//
+// Binary search whose loop has no data-dependent branch - the compare picks
+// between two pointers (a cmov), so there's nothing to mispredict.
+//
+struct branchless_search {
+    template <class K, class Compare>
+    class index {
+    public:
+        void rebuild(const K*, uint32_t) {}
+
+        uint32_t lower_bound(const K* keys, uint32_t n, const K& key, const Compare& comp) const {
+            if (n == 0) {
+                return 0;
+            }
+            const K* base = keys;
+            while (n > 1) {
+                uint32_t half = n / 2;
+                base = comp(base[half - 1], key) ? base + half : base;
+                n -= half;
+            }
+            return static_cast<uint32_t>(base - keys) + comp(*base, key);
+        }
+    };
+};
+
+//
+// Binary search over a copy of the keys in Eytzinger (BFS, 1-indexed) order -
+// the children of node k are 2k and 2k + 1. The top of the implicit tree
+// shares a handful of cache lines, and the next levels can be prefetched
+// ahead of the compares.
+//
+// The copy (plus each node's sorted position) is rebuilt after every
+// modification, so this suits maps that are built once and then read.
+//
+struct eytzinger_search {
+    template <class K, class Compare>
+    class index {
+    private:
+        vector<K> layout;       // layout[0] unused
+        vector<uint32_t> rank;  // sorted position of layout[k]
+
+        uint32_t build(const K* sorted, uint32_t i, uint32_t k, uint32_t n) {
+            if (k <= n) {
+                i = build(sorted, i, 2 * k, n);
+                layout[k] = sorted[i];
+                rank[k] = i++;
+                i = build(sorted, i, 2 * k + 1, n);
+            }
+            return i;
+        }
+
+    public:
+        void rebuild(const K* sorted, uint32_t n) {
+            layout.clear();
+            rank.clear();
+            layout.resize(n + 1);
+            rank.resize(n + 1);
+            build(sorted, 0, 1, n);
+        }
+
+        uint32_t lower_bound(const K*, uint32_t n, const K& key, const Compare& comp) const {
+            const K* tree = layout.data();
+            uint32_t k = 1;
+            while (k <= n) {
+                __builtin_prefetch(tree + 16 * k); // 4 levels down
+                k = 2 * k + comp(tree[k], key);
+            }
+
+            // undo the right turns taken after the last left turn
+            k >>= __builtin_ffs(~k);
+            return k == 0 ? n : rank.data()[k];
+        }
+    };
+};
+
+//////////////////////////////////////////////////////
+// flat_map
+//////////////////////////////////////////////////////
+
+//
+// Sorted associative container over two rack::vectors - one of keys, one of
+// values - so a lookup only walks the (densely packed) keys.
+//
+// Lookups are O(log n). Inserting or erasing one element is O(n) (the tail
+// shifts), so build in bulk where possible:
+//      - the range constructor sorts and de-duplicates its input in one go AND;
+//      - a range insert() merges a sorted batch in, in O(n + m log m).
+//
+// Duplicate keys keep the first occurrence, as std::map::insert does.
+//
+template <class K, class V, class Compare = std::less<K>, class Search = branchless_search>
+class flat_map {
+private:
+    vector<K> _keys;
+    vector<V> _values;
+    Compare comp;
+    typename Search::template index<K, Compare> searchIndex;
+
+public:
+    using key_type = K;
+    using mapped_type = V;
+
+    //////////////////////////////////////////////////////
+    // Iterators
+    //////////////////////////////////////////////////////
+
+    //
+    // Dereferences to a std::pair of references into the two vectors - take it
+    // by value or `auto&&` (e.g. `for (auto [k, v] : m)`).
+    //
+    template <bool Const>
+    class Iterator {
+    private:
+        using Value = typename std::conditional<Const, const V, V>::type;
+
+        const K* key;
+        Value* val;
+
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = std::pair<K, V>;
+        using reference         = std::pair<const K&, Value&>;
+
+        struct pointer {
+            reference ref;
+            reference* operator->() { return &ref; }
+        };
+
+        Iterator() : key(nullptr), val(nullptr) {}
+        Iterator(const K* k, Value* v) : key(k), val(v) {}
+
+        template <bool C = Const, class = typename std::enable_if<C>::type>
+        Iterator(const Iterator<false>& other) : key(other.key), val(other.val) {}
+
+        reference operator*() const { return reference(*key, *val); }
+        pointer operator->() const { return pointer{**this}; }
+
+        bool operator==(const Iterator& other) const { return key == other.key; }
+        bool operator!=(const Iterator& other) const { return key != other.key; }
+        bool operator<(const Iterator& other) const { return key < other.key; }
+        bool operator>(const Iterator& other) const { return key > other.key; }
+        bool operator<=(const Iterator& other) const { return key <= other.key; }
+        bool operator>=(const Iterator& other) const { return key >= other.key; }
+
+        Iterator& operator++() { ++key; ++val; return *this; }
+        Iterator operator++(int) { Iterator tmp = *this; ++(*this); return tmp; }
+        Iterator& operator--() { --key; --val; return *this; }
+        Iterator operator--(int) { Iterator tmp = *this; --(*this); return tmp; }
+
+        Iterator& operator+=(difference_type i) { key += i; val += i; return *this; }
+        Iterator& operator-=(difference_type i) { key -= i; val -= i; return *this; }
+        Iterator operator+(difference_type i) const { return Iterator(key + i, val + i); }
+        Iterator operator-(difference_type i) const { return Iterator(key - i, val - i); }
+        friend Iterator operator+(difference_type i, const Iterator& it) { return it + i; }
+        difference_type operator-(const Iterator& other) const { return key - other.key; }
+
+        reference operator[](difference_type i) const { return reference(key[i], val[i]); }
+
+        template <bool> friend class Iterator;
+        friend class flat_map;
+    };
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    iterator begin() { return iterator(_keys.data(), _values.data()); }
+    iterator end() { return begin() + _keys.size(); }
+    const_iterator begin() const { return const_iterator(_keys.data(), _values.data()); }
+    const_iterator end() const { return begin() + _keys.size(); }
+
+    //////////////////////////////////////////////////////
+    // Construtors
+    //////////////////////////////////////////////////////
+
+    flat_map() {}
+
+    // Bulk construction from unsorted (key, value) pairs - sorts, then de-duplicates.
+    template <class It>
+    flat_map(It first, It last) {
+        insert(first, last);
+    }
+
+    flat_map(std::initializer_list<std::pair<K, V>> init)
+        : flat_map(init.begin(), init.end()) {}
+
+    //////////////////////////////////////////////////////
+    // Lookup
+    //////////////////////////////////////////////////////
+
+    // Position of the first key not less than `key`.
+    uint32_t lower_bound_index(const K& key) const {
+        return searchIndex.lower_bound(_keys.data(), _keys.size(), key, comp);
+    }
+
+    iterator lower_bound(const K& key) {
+        return begin() + lower_bound_index(key);
+    }
+
+    iterator find(const K& key) {
+        uint32_t i = findIndex(key);
+        return i == _keys.size() ? end() : begin() + i;
+    }
+
+    const_iterator find(const K& key) const {
+        uint32_t i = findIndex(key);
+        return i == _keys.size() ? end() : begin() + i;
+    }
+
+    bool contains(const K& key) const {
+        return findIndex(key) != _keys.size();
+    }
+
+    uint32_t count(const K& key) const {
+        return contains(key) ? 1 : 0;
+    }
+
+    V& at(const K& key) {
+        uint32_t i = findIndex(key);
+        if (i == _keys.size()) {
+            throw std::runtime_error("Key not found");
+        }
+        return _values.data()[i];
+    }
+
+    const V& at(const K& key) const {
+        return const_cast<flat_map*>(this)->at(key);
+    }
+
+    // Value for `key`, default-inserted if absent
+    V& operator[](const K& key) {
+        return insert({key, V()}).first->second;
+    }
+
+    // The sorted keys, and their values (same order).
+    const vector<K>& keys() const { return _keys; }
+    const vector<V>& values() const { return _values; }
+
+    //////////////////////////////////////////////////////
+    // Modifiers
+    //////////////////////////////////////////////////////
+
+    //
+    // Inserts `kv` if its key is absent (O(n)). Returns the element with that
+    // key, and whether it was inserted.
+    //
+    std::pair<iterator, bool> insert(const std::pair<K, V>& kv) {
+        uint32_t i = lower_bound_index(kv.first);
+        if (i < _keys.size() && !comp(kv.first, _keys.data()[i])) {
+            return {begin() + i, false};
+        }
+        _keys.insert(kv.first, i);
+        _values.insert(kv.second, i);
+        searchIndex.rebuild(_keys.data(), _keys.size());
+        return {begin() + i, true};
+    }
+
+    //
+    // Inserts a batch of (key, value) pairs, in any order. The batch is sorted
+    // and de-duplicated, then merged with the existing elements in one pass -
+    // rather than one O(n) insert per element.
+    //
+    template <class It>
+    void insert(It first, It last) {
+        // sort the batch (stably, so the first of any duplicates wins)
+        vector<std::pair<K, V>> batch;
+        for (; first != last; ++first) {
+            batch.push_back(*first);
+        }
+        std::pair<K, V>* b = batch.data();
+        std::pair<K, V>* bEnd = b + batch.size();
+        std::stable_sort(b, bEnd, [this](const std::pair<K, V>& x, const std::pair<K, V>& y) {
+            return comp(x.first, y.first);
+        });
+
+        //
+        // merge - on equal keys, the existing element wins, and later copies
+        // within the batch are skipped
+        //
+        vector<K> keys;
+        vector<V> values;
+        keys.reserve(_keys.size() + batch.size());
+        values.reserve(_keys.size() + batch.size());
+
+        K* k = _keys.data();
+        V* v = _values.data();
+        K* kEnd = k + _keys.size();
+        while (k != kEnd || b != bEnd) {
+            bool takeBatch = k == kEnd || (b != bEnd && comp(b->first, *k));
+            if (takeBatch) {
+                if (keys.empty() || comp(keys.back(), b->first)) {
+                    keys.push_back(std::move(b->first));
+                    values.push_back(std::move(b->second));
+                }
+                ++b;
+            } else {
+                // skip batch entries equal to this (existing) key
+                while (b != bEnd && !comp(*k, b->first)) {
+                    ++b;
+                }
+                keys.push_back(std::move(*k++));
+                values.push_back(std::move(*v++));
+            }
+        }
+
+        _keys.swap(keys);
+        _values.swap(values);
+        searchIndex.rebuild(_keys.data(), _keys.size());
+    }
+
+    // Erases the element with `key`, if any. Returns the number erased.
+    uint32_t erase(const K& key) {
+        uint32_t i = findIndex(key);
+        if (i == _keys.size()) {
+            return 0;
+        }
+        _keys.erase(i);
+        _values.erase(i);
+        searchIndex.rebuild(_keys.data(), _keys.size());
+        return 1;
+    }
+
+    void clear() {
+        _keys.clear();
+        _values.clear();
+        searchIndex.rebuild(_keys.data(), 0);
+    }
+
+    void reserve(uint32_t n) {
+        _keys.reserve(n);
+        _values.reserve(n);
+    }
+
+    //////////////////////////////////////////////////////
+    // Capacity
+    //////////////////////////////////////////////////////
+
+    bool empty() const { return _keys.empty(); }
+    uint32_t size() const { return _keys.size(); }
+
+private:
+
+    // Position of `key`, or size() if absent.
+    uint32_t findIndex(const K& key) const {
+        uint32_t i = lower_bound_index(key);
+        if (i < _keys.size() && !comp(key, _keys.data()[i])) {
+            return i;
+        }
+        return _keys.size();
+    }
+};
+
+//////////////////////////////////////////////////////
+// flat_set
+//////////////////////////////////////////////////////
+
+//
+// Sorted set over one rack::vector of keys - see flat_map.
+//
+template <class K, class Compare = std::less<K>, class Search = branchless_search>
+class flat_set {
+private:
+    vector<K> _keys;
+    Compare comp;
+    typename Search::template index<K, Compare> searchIndex;
+
+public:
+    using key_type = K;
+    using value_type = K;
+    using iterator = const K*;
+    using const_iterator = const K*;
+
+    iterator begin() const { return _keys.data(); }
+    iterator end() const { return _keys.data() + _keys.size(); }
+
+    //////////////////////////////////////////////////////
+    // Construtors
+    //////////////////////////////////////////////////////
+
+    flat_set() {}
+
+    // Bulk construction from unsorted keys - sorts, then de-duplicates.
+    template <class It>
+    flat_set(It first, It last) {
+        insert(first, last);
+    }
+
+    flat_set(std::initializer_list<K> init)
+        : flat_set(init.begin(), init.end()) {}
+
+    //////////////////////////////////////////////////////
+    // Lookup
+    //////////////////////////////////////////////////////
+
+    uint32_t lower_bound_index(const K& key) const {
+        return searchIndex.lower_bound(_keys.data(), _keys.size(), key, comp);
+    }
+
+    iterator lower_bound(const K& key) const {
+        return begin() + lower_bound_index(key);
+    }
+
+    iterator find(const K& key) const {
+        uint32_t i = lower_bound_index(key);
+        if (i < _keys.size() && !comp(key, _keys.data()[i])) {
+            return begin() + i;
+        }
+        return end();
+    }
+
+    bool contains(const K& key) const {
+        return find(key) != end();
+    }
+
+    uint32_t count(const K& key) const {
+        return contains(key) ? 1 : 0;
+    }
+
+    // The sorted keys.
+    const vector<K>& keys() const { return _keys; }
+
+    //////////////////////////////////////////////////////
+    // Modifiers
+    //////////////////////////////////////////////////////
+
+    // Inserts `key` if absent (O(n)).
+    std::pair<iterator, bool> insert(const K& key) {
+        uint32_t i = lower_bound_index(key);
+        if (i < _keys.size() && !comp(key, _keys.data()[i])) {
+            return {begin() + i, false};
+        }
+        _keys.insert(key, i);
+        searchIndex.rebuild(_keys.data(), _keys.size());
+        return {begin() + i, true};
+    }
+
+    // Inserts a batch of keys, in any order - sorted, de-duplicated and merged in one pass.
+    template <class It>
+    void insert(It first, It last) {
+        vector<K> batch;
+        for (; first != last; ++first) {
+            batch.push_back(*first);
+        }
+        K* b = batch.data();
+        K* bEnd = b + batch.size();
+        std::sort(b, bEnd, comp);
+
+        vector<K> keys;
+        keys.reserve(_keys.size() + batch.size());
+
+        K* k = _keys.data();
+        K* kEnd = k + _keys.size();
+        while (k != kEnd || b != bEnd) {
+            // the smaller of the two heads (existing on ties), skipping anything already taken
+            K* next = (k == kEnd || (b != bEnd && comp(*b, *k))) ? b++ : k++;
+            if (keys.empty() || comp(keys.back(), *next)) {
+                keys.push_back(std::move(*next));
+            }
+        }
+
+        _keys.swap(keys);
+        searchIndex.rebuild(_keys.data(), _keys.size());
+    }
+
+    uint32_t erase(const K& key) {
+        iterator it = find(key);
+        if (it == end()) {
+            return 0;
+        }
+        _keys.erase(static_cast<uint32_t>(it - begin()));
+        searchIndex.rebuild(_keys.data(), _keys.size());
+        return 1;
+    }
+
+    void clear() {
+        _keys.clear();
+        searchIndex.rebuild(_keys.data(), 0);
+    }
+
+    void reserve(uint32_t n) {
+        _keys.reserve(n);
+    }
+
+    //////////////////////////////////////////////////////
+    // Capacity
+    //////////////////////////////////////////////////////
+
+    bool empty() const { return _keys.empty(); }
+    uint32_t size() const { return _keys.size(); }
+};
+
+}; // end of 'rack'
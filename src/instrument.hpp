@@ -0,0 +1,290 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+#if defined(RACK_INSTRUMENT) && defined(__GNUG__)
+#include <cxxabi.h>
+#endif
+
+namespace rack {
+
+//
+// Opt-in allocation and growth instrumentation for the containers.
+//
+// Build with RACK_INSTRUMENT defined (`cmake -DRACK_INSTRUMENT=ON ..`) and each
+// container instantiation (e.g. rack::vector<int>) counts:
+//      - allocations/deallocations, and bytes, of buffers, chunks, chunk maps
+//        and control blocks;
+//      - reallocations - a full buffer moved to a bigger one - along with the
+//        elements copied vs moved to get there AND;
+//      - map regrowths - deque's chunk map doubling.
+//
+// Read them with instrument::snapshot(), or install a dump hook to have them
+// handed over at exit - e.g. to find the vectors that want a reserve().
+//
+// Without RACK_INSTRUMENT every hook is an empty inline function, so the
+// containers compile to exactly what they would without it.
+//
+namespace instrument {
+
+#ifdef RACK_INSTRUMENT
+constexpr bool enabled = true;
+#else
+constexpr bool enabled = false;
+#endif
+
+struct counters {
+    uint64_t allocations = 0;
+    uint64_t deallocations = 0;
+    uint64_t bytes_allocated = 0;
+    uint64_t bytes_freed = 0;
+    uint64_t reallocations = 0;
+    uint64_t element_copies = 0; // during reallocation
+    uint64_t element_moves = 0;  // during reallocation
+    uint64_t map_regrowths = 0;
+
+    counters& operator+=(const counters& o) {
+        allocations += o.allocations;
+        deallocations += o.deallocations;
+        bytes_allocated += o.bytes_allocated;
+        bytes_freed += o.bytes_freed;
+        reallocations += o.reallocations;
+        element_copies += o.element_copies;
+        element_moves += o.element_moves;
+        map_regrowths += o.map_regrowths;
+        return *this;
+    }
+};
+
+// Counters for one container instantiation.
+struct entry {
+    std::string kind; // "vector", "deque", "shared_ptr"
+    std::string type; // full type, e.g. "rack::vector<int>"
+    counters values;
+};
+
+struct stats {
+    std::vector<entry> entries;
+
+    // Sum over every entry of `kind` (or over everything, if null).
+    counters total(const char* kind = nullptr) const {
+        counters sum;
+        for (const entry& e : entries) {
+            if (kind == nullptr || e.kind == kind) {
+                sum += e.values;
+            }
+        }
+        return sum;
+    }
+
+    std::string to_string() const {
+        std::ostringstream oss;
+        oss << "rack::instrument - " << entries.size() << " container type(s)\n";
+        for (const entry& e : entries) {
+            const counters& c = e.values;
+            oss << "  " << e.type << "\n"
+                << "    allocs=" << c.allocations << " frees=" << c.deallocations
+                << " bytes=" << c.bytes_allocated << " freed=" << c.bytes_freed
+                << " reallocs=" << c.reallocations << " copies=" << c.element_copies
+                << " moves=" << c.element_moves << " map_regrowths=" << c.map_regrowths << "\n";
+        }
+        return oss.str();
+    }
+};
+
+//////////////////////////////////////////////////////
+// Records
+//////////////////////////////////////////////////////
+
+namespace detail {
+
+enum Field {
+    ALLOCATIONS, DEALLOCATIONS, BYTES_ALLOCATED, BYTES_FREED,
+    REALLOCATIONS, ELEMENT_COPIES, ELEMENT_MOVES, MAP_REGROWTHS,
+    N_FIELDS
+};
+
+//
+// Live counters for one instantiation. Records are created on first use and
+// pushed onto a global list (never removed), which snapshot() walks.
+//
+struct Record {
+    const char* kind;
+    const std::type_info& type;
+    std::atomic<uint64_t> values[N_FIELDS];
+    Record* next;
+
+    Record(const char* k, const std::type_info& t);
+
+    void add(Field f, uint64_t n) {
+        values[f].fetch_add(n, std::memory_order_relaxed);
+    }
+};
+
+inline std::atomic<Record*> records{nullptr};
+
+inline Record::Record(const char* k, const std::type_info& t)
+    : kind(k), type(t), values{}, next(nullptr) {
+    Record* head = records.load(std::memory_order_relaxed);
+    do {
+        next = head;
+    } while (!records.compare_exchange_weak(head, this, std::memory_order_release,
+                                                        std::memory_order_relaxed));
+}
+
+template <class Container>
+Record& record(const char* kind) {
+    static Record r(kind, typeid(Container));
+    return r;
+}
+
+inline std::string typeName(const std::type_info& t) {
+#if defined(RACK_INSTRUMENT) && defined(__GNUG__)
+    int status = 0;
+    char* name = abi::__cxa_demangle(t.name(), nullptr, nullptr, &status);
+    if (status == 0 && name) {
+        std::string out(name);
+        std::free(name);
+        return out;
+    }
+#endif
+    return t.name();
+}
+
+}; // end of 'detail'
+
+//////////////////////////////////////////////////////
+// Hooks (called by the containers)
+//////////////////////////////////////////////////////
+
+template <class Container>
+inline void allocated(const char* kind, size_t bytes) {
+#ifdef RACK_INSTRUMENT
+    detail::Record& r = detail::record<Container>(kind);
+    r.add(detail::ALLOCATIONS, 1);
+    r.add(detail::BYTES_ALLOCATED, bytes);
+#else
+    (void)kind;
+    (void)bytes;
+#endif
+}
+
+template <class Container>
+inline void freed(const char* kind, size_t bytes) {
+#ifdef RACK_INSTRUMENT
+    detail::Record& r = detail::record<Container>(kind);
+    r.add(detail::DEALLOCATIONS, 1);
+    r.add(detail::BYTES_FREED, bytes);
+#else
+    (void)kind;
+    (void)bytes;
+#endif
+}
+
+// A buffer was outgrown, and its elements carried to a new one.
+template <class Container>
+inline void reallocated(const char* kind, uint64_t copies, uint64_t moves) {
+#ifdef RACK_INSTRUMENT
+    detail::Record& r = detail::record<Container>(kind);
+    r.add(detail::REALLOCATIONS, 1);
+    r.add(detail::ELEMENT_COPIES, copies);
+    r.add(detail::ELEMENT_MOVES, moves);
+#else
+    (void)kind;
+    (void)copies;
+    (void)moves;
+#endif
+}
+
+template <class Container>
+inline void map_regrown(const char* kind) {
+#ifdef RACK_INSTRUMENT
+    detail::record<Container>(kind).add(detail::MAP_REGROWTHS, 1);
+#else
+    (void)kind;
+#endif
+}
+
+//////////////////////////////////////////////////////
+// Querying
+//////////////////////////////////////////////////////
+
+// Current counts, per instantiation (empty without RACK_INSTRUMENT).
+inline stats snapshot() {
+    stats s;
+    for (detail::Record* r = detail::records.load(std::memory_order_acquire); r; r = r->next) {
+        entry e;
+        e.kind = r->kind;
+        e.type = detail::typeName(r->type);
+
+        uint64_t v[detail::N_FIELDS];
+        for (int f = 0; f < detail::N_FIELDS; f++) {
+            v[f] = r->values[f].load(std::memory_order_relaxed);
+        }
+        e.values.allocations = v[detail::ALLOCATIONS];
+        e.values.deallocations = v[detail::DEALLOCATIONS];
+        e.values.bytes_allocated = v[detail::BYTES_ALLOCATED];
+        e.values.bytes_freed = v[detail::BYTES_FREED];
+        e.values.reallocations = v[detail::REALLOCATIONS];
+        e.values.element_copies = v[detail::ELEMENT_COPIES];
+        e.values.element_moves = v[detail::ELEMENT_MOVES];
+        e.values.map_regrowths = v[detail::MAP_REGROWTHS];
+        s.entries.push_back(e);
+    }
+    return s;
+}
+
+// Zeroes every count (e.g. between phases of a program).
+inline void reset() {
+    for (detail::Record* r = detail::records.load(std::memory_order_acquire); r; r = r->next) {
+        for (auto& v : r->values) {
+            v.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+//////////////////////////////////////////////////////
+// Dump hook
+//////////////////////////////////////////////////////
+
+using dump_hook = void (*)(const stats&);
+
+namespace detail {
+
+struct ExitDump {
+    std::atomic<dump_hook> hook{nullptr};
+
+    ~ExitDump() {
+        if (dump_hook h = hook.load()) {
+            h(snapshot());
+        }
+    }
+};
+
+inline ExitDump exitDump;
+
+}; // end of 'detail'
+
+//
+// Has `hook` called with the final snapshot at program exit (nullptr removes
+// it). E.g.
+//
+//      rack::instrument::set_dump_hook([](const rack::instrument::stats& s) {
+//          std::cerr << s.to_string();
+//      });
+//
+inline void set_dump_hook(dump_hook hook) {
+    detail::exitDump.hook.store(hook);
+}
+
+}; // end of 'instrument'
+
+}; // end of 'rack'
@@ -0,0 +1,727 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "epoch.hpp"
+#include "instrument.hpp"
+
+namespace rack {
+
+namespace detail {
+
+constexpr size_t CACHE_LINE = 64;
+
+//
+// Backoff while another thread finishes something it has already started
+// (e.g. writing a claimed slot) - spin briefly, then yield, in case it was
+// preempted.
+//
+inline void relax(uint32_t& spins) {
+    if (++spins < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    } else {
+        std::this_thread::yield();
+    }
+}
+
+//
+// Sleep/wake for the blocking queue operations, on a futex.
+//
+// A waiter registers, snapshots `seq`, retries its operation, and only then
+// sleeps on `seq`. A notifier (after publishing) checks for waiters with an
+// RMW - which orders it after the publish against the waiter's registration,
+// so either the waiter's retry sees the publish, or the notifier sees the
+// waiter and bumps `seq` (making the sleep return at once, or waking it).
+//
+// Without waiters, notify() costs one RMW. Off Linux, sleeping degrades to
+// yielding.
+//
+class futex_event {
+private:
+    static constexpr uint32_t SPIN_LIMIT = 128;
+
+    std::atomic<uint32_t> seq{0};
+    std::atomic<uint32_t> waiters{0};
+
+    static void sleep(std::atomic<uint32_t>* addr, uint32_t expected) {
+#ifdef __linux__
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAIT_PRIVATE, expected,
+                nullptr, nullptr, 0);
+#else
+        (void)addr;
+        (void)expected;
+        std::this_thread::yield();
+#endif
+    }
+
+    static void wakeAll(std::atomic<uint32_t>* addr) {
+#ifdef __linux__
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAKE_PRIVATE, INT_MAX,
+                nullptr, nullptr, 0);
+#else
+        (void)addr;
+#endif
+    }
+
+public:
+
+    //
+    // Calls `attempt()` until it returns true. Spins (then yields) for a
+    // while first - a wait is usually short, and cheaper than a sleep/wake
+    // round trip - then sleeps between failures until notified.
+    //
+    template <class Attempt>
+    void wait(Attempt attempt) {
+        for (uint32_t spins = 0; spins < SPIN_LIMIT;) {
+            if (attempt()) {
+                return;
+            }
+            relax(spins);
+        }
+        while (!attempt()) {
+            waiters.fetch_add(1, std::memory_order_seq_cst);
+            bool done;
+            try {
+                uint32_t s = seq.load(std::memory_order_seq_cst);
+                done = attempt();
+                if (!done) {
+                    sleep(&seq, s);
+                }
+            } catch (...) {
+                waiters.fetch_sub(1, std::memory_order_seq_cst);
+                throw;
+            }
+            waiters.fetch_sub(1, std::memory_order_seq_cst);
+            if (done) {
+                return;
+            }
+        }
+    }
+
+    // Wakes all waiters - call after publishing something an attempt could use.
+    void notify() {
+        if (waiters.fetch_add(0, std::memory_order_seq_cst) != 0) {
+            seq.fetch_add(1, std::memory_order_seq_cst);
+            wakeAll(&seq);
+        }
+    }
+};
+
+}; // end of 'detail'
+
+//////////////////////////////////////////////////////
+// mpmc_queue (bounded)
+//////////////////////////////////////////////////////
+
+//
+// Bounded multi-producer, multi-consumer FIFO queue (Dmitry Vyukov's design).
+//
+// A ring of cells, each with a sequence number saying whose turn it is: cell
+// i % capacity is free for the enqueue at position i when seq == i, and holds
+// that element for the dequeue at position i when seq == i + 1 (the consumer
+// then sets it to i + capacity, freeing it for the next lap). Producers and
+// consumers claim positions with a CAS on their own (cache line padded)
+// counter, then touch only their cell - no locks, and a producer and consumer
+// never contend unless the queue is nearly empty or full.
+//
+// Batch operations claim a run of consecutive cells with one CAS.
+//
+// If T's constructor throws in a push, the claimed cell is published as a
+// "skip" (which consumers free and pass over) and the exception propagates -
+// the queue stays usable.
+//
+// With Blocking = true, push()/pop() sleep on a futex while the queue is
+// full/empty. (Every operation then also checks for sleepers, so leave it
+// off for purely non-blocking use.)
+//
+template <class T, bool Blocking = false>
+class mpmc_queue {
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        bool skip; // published with `seq` - no element (its construction threw)
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+        T* value() { return reinterpret_cast<T*>(&storage); }
+    };
+
+    Cell* cells;
+    size_t mask;
+
+    alignas(detail::CACHE_LINE) std::atomic<size_t> enqueuePos;
+    alignas(detail::CACHE_LINE) std::atomic<size_t> dequeuePos;
+    alignas(detail::CACHE_LINE) detail::futex_event notEmpty;
+    alignas(detail::CACHE_LINE) detail::futex_event notFull;
+
+public:
+
+    //////////////////////////////////////////////////////
+    // Construtors
+    //////////////////////////////////////////////////////
+
+    // Holds up to `capacity` elements (rounded up to a power of two, at least 2).
+    explicit mpmc_queue(size_t capacity)
+        : enqueuePos(0), dequeuePos(0) {
+        size_t cap = 2;
+        while (cap < capacity) {
+            cap *= 2;
+        }
+        mask = cap - 1;
+
+        instrument::allocated<mpmc_queue>("mpmc_queue", sizeof(Cell) * cap);
+        cells = static_cast<Cell*>(::operator new(sizeof(Cell) * cap));
+        for (size_t i = 0; i < cap; i++) {
+            new (&cells[i].seq) std::atomic<size_t>(i);
+            cells[i].skip = false;
+        }
+    }
+
+    ~mpmc_queue() {
+        size_t end = enqueuePos.load(std::memory_order_relaxed);
+        for (size_t pos = dequeuePos.load(std::memory_order_relaxed); pos != end; pos++) {
+            if (!cells[pos & mask].skip) {
+                cells[pos & mask].value()->~T();
+            }
+        }
+        instrument::freed<mpmc_queue>("mpmc_queue", sizeof(Cell) * (mask + 1));
+        ::operator delete(cells);
+    }
+
+    mpmc_queue(const mpmc_queue&) = delete;
+    mpmc_queue& operator=(const mpmc_queue&) = delete;
+
+    //////////////////////////////////////////////////////
+    // Non-blocking operations
+    //////////////////////////////////////////////////////
+
+    bool try_push(const T& val) {
+        return try_emplace(val);
+    }
+
+    bool try_push(T&& val) {
+        return try_emplace(std::move(val));
+    }
+
+    // Constructs an element from `args` at the back. Returns false if full (`args` untouched).
+    template <class... Args>
+    bool try_emplace(Args&&... args) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells[pos & mask];
+            intptr_t diff = static_cast<intptr_t>(cell->seq.load(std::memory_order_acquire))
+                          - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false; // a lap behind - full
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        try {
+            new (cell->value()) T(std::forward<Args>(args)...);
+        } catch (...) {
+            cell->skip = true;
+            cell->seq.store(pos + 1, std::memory_order_release);
+            throw;
+        }
+        cell->seq.store(pos + 1, std::memory_order_release);
+        notifyNotEmpty();
+        return true;
+    }
+
+    // Moves the front element into `out`. Returns false if empty.
+    bool try_pop(T& out) {
+        while (true) {
+            size_t pos = dequeuePos.load(std::memory_order_relaxed);
+            Cell* cell;
+            while (true) {
+                cell = &cells[pos & mask];
+                intptr_t diff = static_cast<intptr_t>(cell->seq.load(std::memory_order_acquire))
+                              - static_cast<intptr_t>(pos + 1);
+                if (diff == 0) {
+                    if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    return false; // not yet written - empty
+                } else {
+                    pos = dequeuePos.load(std::memory_order_relaxed);
+                }
+            }
+
+            bool skipped = cell->skip;
+            if (!skipped) {
+                out = std::move(*cell->value());
+                cell->value()->~T();
+            }
+            cell->skip = false;
+            cell->seq.store(pos + mask + 1, std::memory_order_release);
+            notifyNotFull();
+            if (!skipped) {
+                return true;
+            }
+        }
+    }
+
+    //
+    // Pushes up to `n` elements from `first`, claiming the free cells at the
+    // back with one CAS. Returns how many were pushed (0 if full).
+    //
+    template <class It>
+    size_t try_push_bulk(It first, size_t n) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        size_t k;
+        while (true) {
+            // consecutive cells free for this lap
+            k = 0;
+            while (k < n && cells[(pos + k) & mask].seq.load(std::memory_order_acquire) == pos + k) {
+                k++;
+            }
+            if (k > 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + k, std::memory_order_relaxed)) {
+                    break;
+                }
+                continue;
+            }
+            if (n == 0 || static_cast<intptr_t>(cells[pos & mask].seq.load(std::memory_order_acquire)) -
+                          static_cast<intptr_t>(pos) < 0) {
+                return 0; // full
+            }
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+
+        for (size_t i = 0; i < k; i++, ++first) {
+            Cell& cell = cells[(pos + i) & mask];
+            try {
+                new (cell.value()) T(*first);
+            } catch (...) {
+                // skip the rest of the run - the elements before it stay pushed
+                for (; i < k; i++) {
+                    cells[(pos + i) & mask].skip = true;
+                    cells[(pos + i) & mask].seq.store(pos + i + 1, std::memory_order_release);
+                }
+                notifyNotEmpty();
+                throw;
+            }
+            cell.seq.store(pos + i + 1, std::memory_order_release);
+        }
+        notifyNotEmpty();
+        return k;
+    }
+
+    //
+    // Pops up to `max` elements to `out`, claiming the ready cells at the
+    // front with one CAS. Returns how many were popped (0 if empty).
+    //
+    template <class OutIt>
+    size_t try_pop_bulk(OutIt out, size_t max) {
+        size_t popped = 0;
+        while (popped == 0) {
+            size_t pos = dequeuePos.load(std::memory_order_relaxed);
+            size_t k;
+            while (true) {
+                k = 0;
+                while (k < max && cells[(pos + k) & mask].seq.load(std::memory_order_acquire) == pos + k + 1) {
+                    k++;
+                }
+                if (k > 0) {
+                    if (dequeuePos.compare_exchange_weak(pos, pos + k, std::memory_order_relaxed)) {
+                        break;
+                    }
+                    continue;
+                }
+                if (max == 0 || static_cast<intptr_t>(cells[pos & mask].seq.load(std::memory_order_acquire)) -
+                                static_cast<intptr_t>(pos + 1) < 0) {
+                    return 0; // empty
+                }
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+
+            for (size_t i = 0; i < k; i++) {
+                Cell& cell = cells[(pos + i) & mask];
+                if (!cell.skip) {
+                    *out++ = std::move(*cell.value());
+                    cell.value()->~T();
+                    popped++;
+                }
+                cell.skip = false;
+                cell.seq.store(pos + i + mask + 1, std::memory_order_release);
+            }
+            notifyNotFull();
+        }
+        return popped;
+    }
+
+    //////////////////////////////////////////////////////
+    // Blocking operations (Blocking = true)
+    //////////////////////////////////////////////////////
+
+    // Pushes `val`, sleeping while the queue is full.
+    void push(T val) {
+        static_assert(Blocking, "push() needs mpmc_queue<T, true>");
+        notFull.wait([&]() { return try_push(std::move(val)); });
+    }
+
+    // Pops the front element into `out`, sleeping while the queue is empty.
+    void pop(T& out) {
+        static_assert(Blocking, "pop() needs mpmc_queue<T, true>");
+        notEmpty.wait([&]() { return try_pop(out); });
+    }
+
+    //////////////////////////////////////////////////////
+    // Capacity
+    //////////////////////////////////////////////////////
+
+    size_t capacity() const {
+        return mask + 1;
+    }
+
+    // Elements in the queue (a snapshot - may be stale by the time it returns).
+    size_t size_approx() const {
+        size_t deq = dequeuePos.load(std::memory_order_relaxed);
+        size_t enq = enqueuePos.load(std::memory_order_relaxed);
+        return enq > deq ? enq - deq : 0;
+    }
+
+private:
+
+    void notifyNotEmpty() {
+        if (Blocking) {
+            notEmpty.notify();
+        }
+    }
+
+    void notifyNotFull() {
+        if (Blocking) {
+            notFull.notify();
+        }
+    }
+};
+
+//////////////////////////////////////////////////////
+// unbounded_mpmc_queue
+//////////////////////////////////////////////////////
+
+//
+// Unbounded multi-producer, multi-consumer FIFO queue - a linked list of
+// fixed-size chunks, filled front to back like deque's chunks.
+//
+// Producers claim a slot in the tail chunk with a fetch_add on its enqueue
+// index; the producer that overflows it links a fresh chunk. Consumers claim
+// slots in the head chunk with a CAS on its dequeue index (never past what's
+// been claimed for enqueue), then wait for the slot's ready flag - the
+// producer is already writing it.
+//
+// Chunks are only read inside an epoch::guard. A consumer that finds the head
+// chunk exhausted unlinks it and epoch::retire()s it; once no guard can still
+// see it, it goes back to a small pool of free chunks (shared by every queue
+// of the same type), which the next chunk allocation reuses.
+//
+// If T's constructor throws in a push, the claimed slot is marked SKIP
+// (consumers pass over it) and the exception propagates - a consumer that
+// claimed the slot never waits on it forever.
+//
+// With Blocking = true, pop() sleeps on a futex while the queue is empty.
+//
+template <class T, bool Blocking = false, uint32_t ChunkSize = 1024>
+class unbounded_mpmc_queue {
+private:
+    static constexpr uint32_t MAX_POOLED_CHUNKS = 64;
+
+    // Slot states, in Chunk::ready
+    static constexpr uint8_t PENDING = 0; // claimed, being written
+    static constexpr uint8_t READY = 1;
+    static constexpr uint8_t SKIP = 2;    // no element - its construction threw
+
+    struct Chunk {
+        alignas(detail::CACHE_LINE) std::atomic<size_t> enqIdx;
+        alignas(detail::CACHE_LINE) std::atomic<size_t> deqIdx;
+        std::atomic<Chunk*> next;
+        std::atomic<uint8_t> ready[ChunkSize];
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type slots[ChunkSize];
+
+        Chunk() {
+            reset();
+        }
+
+        void reset() {
+            enqIdx.store(0, std::memory_order_relaxed);
+            deqIdx.store(0, std::memory_order_relaxed);
+            next.store(nullptr, std::memory_order_relaxed);
+            for (auto& r : ready) {
+                r.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        T* slot(size_t i) { return reinterpret_cast<T*>(&slots[i]); }
+    };
+
+    struct ChunkPool {
+        std::mutex lock;
+        Chunk* head = nullptr; // linked through Chunk::next
+        uint32_t count = 0;
+
+        ~ChunkPool() {
+            while (head != nullptr) {
+                Chunk* c = head;
+                head = c->next.load(std::memory_order_relaxed);
+                deleteChunk(c);
+            }
+        }
+    };
+
+    alignas(detail::CACHE_LINE) std::atomic<Chunk*> head;
+    alignas(detail::CACHE_LINE) std::atomic<Chunk*> tail;
+    alignas(detail::CACHE_LINE) detail::futex_event notEmpty;
+
+public:
+
+    //////////////////////////////////////////////////////
+    // Construtors
+    //////////////////////////////////////////////////////
+
+    unbounded_mpmc_queue() {
+        Chunk* c = acquireChunk();
+        head.store(c, std::memory_order_relaxed);
+        tail.store(c, std::memory_order_relaxed);
+    }
+
+    ~unbounded_mpmc_queue() {
+        Chunk* c = head.load(std::memory_order_relaxed);
+        while (c != nullptr) {
+            size_t end = std::min<size_t>(c->enqIdx.load(std::memory_order_relaxed), ChunkSize);
+            for (size_t j = c->deqIdx.load(std::memory_order_relaxed); j < end; j++) {
+                if (c->ready[j].load(std::memory_order_relaxed) == READY) {
+                    c->slot(j)->~T();
+                }
+            }
+            Chunk* next = c->next.load(std::memory_order_relaxed);
+            recycleChunk(c);
+            c = next;
+        }
+    }
+
+    unbounded_mpmc_queue(const unbounded_mpmc_queue&) = delete;
+    unbounded_mpmc_queue& operator=(const unbounded_mpmc_queue&) = delete;
+
+    //////////////////////////////////////////////////////
+    // Operations
+    //////////////////////////////////////////////////////
+
+    void push(const T& val) {
+        emplace(val);
+    }
+
+    void push(T&& val) {
+        emplace(std::move(val));
+    }
+
+    template <class... Args>
+    void emplace(Args&&... args) {
+        {
+            epoch::guard g;
+            while (true) {
+                Chunk* t = tail.load(std::memory_order_acquire);
+                size_t i = t->enqIdx.fetch_add(1, std::memory_order_acq_rel);
+                if (i < ChunkSize) {
+                    try {
+                        new (t->slot(i)) T(std::forward<Args>(args)...);
+                    } catch (...) {
+                        t->ready[i].store(SKIP, std::memory_order_release);
+                        throw;
+                    }
+                    t->ready[i].store(READY, std::memory_order_release);
+                    break;
+                }
+                advanceTail(t);
+            }
+        }
+        notifyNotEmpty();
+    }
+
+    // Pushes `n` elements from `first`, claiming a run of each chunk with one CAS.
+    template <class It>
+    void push_bulk(It first, size_t n) {
+        {
+            epoch::guard g;
+            while (n > 0) {
+                Chunk* t = tail.load(std::memory_order_acquire);
+                size_t i = t->enqIdx.load(std::memory_order_relaxed);
+                if (i >= ChunkSize) {
+                    advanceTail(t);
+                    continue;
+                }
+                size_t k = std::min<size_t>(n, ChunkSize - i);
+                if (!t->enqIdx.compare_exchange_weak(i, i + k, std::memory_order_acq_rel)) {
+                    continue;
+                }
+                for (size_t j = i; j < i + k; j++, ++first) {
+                    try {
+                        new (t->slot(j)) T(*first);
+                    } catch (...) {
+                        // skip the rest of the run - the elements before it stay pushed
+                        for (; j < i + k; j++) {
+                            t->ready[j].store(SKIP, std::memory_order_release);
+                        }
+                        notifyNotEmpty();
+                        throw;
+                    }
+                    t->ready[j].store(READY, std::memory_order_release);
+                }
+                n -= k;
+            }
+        }
+        notifyNotEmpty();
+    }
+
+    // Moves the front element into `out`. Returns false if empty.
+    bool try_pop(T& out) {
+        return try_pop_bulk(&out, 1) == 1;
+    }
+
+    //
+    // Pops up to `max` elements to `out`, claiming a run of each chunk with
+    // one CAS. Returns how many were popped (0 if empty).
+    //
+    template <class OutIt>
+    size_t try_pop_bulk(OutIt out, size_t max) {
+        epoch::guard g;
+        size_t popped = 0;
+        while (popped < max) {
+            Chunk* h = head.load(std::memory_order_acquire);
+            size_t d = h->deqIdx.load(std::memory_order_acquire);
+
+            // head chunk used up - move on to the next, if there is one
+            if (d >= ChunkSize) {
+                Chunk* next = h->next.load(std::memory_order_acquire);
+                if (next == nullptr) {
+                    break;
+                }
+                // tail must be past it too before it's unreachable
+                Chunk* t = h;
+                tail.compare_exchange_strong(t, next, std::memory_order_acq_rel);
+                if (head.compare_exchange_strong(h, next, std::memory_order_acq_rel)) {
+                    epoch::retire(h, &recycleChunk);
+                }
+                continue;
+            }
+
+            size_t claimed = std::min<size_t>(h->enqIdx.load(std::memory_order_acquire), ChunkSize);
+            if (d >= claimed) {
+                break; // empty
+            }
+            size_t k = std::min(max - popped, claimed - d);
+            if (!h->deqIdx.compare_exchange_weak(d, d + k, std::memory_order_acq_rel)) {
+                continue;
+            }
+
+            for (size_t j = d; j < d + k; j++) {
+                uint32_t spins = 0;
+                uint8_t state;
+                while ((state = h->ready[j].load(std::memory_order_acquire)) == PENDING) {
+                    detail::relax(spins);
+                }
+                if (state == READY) {
+                    *out++ = std::move(*h->slot(j));
+                    h->slot(j)->~T();
+                    popped++;
+                }
+            }
+        }
+        return popped;
+    }
+
+    // Pops the front element into `out`, sleeping while the queue is empty.
+    void pop(T& out) {
+        static_assert(Blocking, "pop() needs unbounded_mpmc_queue<T, true>");
+        notEmpty.wait([&]() { return try_pop(out); });
+    }
+
+private:
+
+    // Links a new chunk after full chunk `t` (unless another thread has), and moves the tail on.
+    void advanceTail(Chunk* t) {
+        Chunk* next = t->next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+            Chunk* fresh = acquireChunk();
+            if (t->next.compare_exchange_strong(next, fresh, std::memory_order_acq_rel)) {
+                next = fresh;
+            } else {
+                recycleChunk(fresh); // never visible to another thread
+            }
+        }
+        tail.compare_exchange_strong(t, next, std::memory_order_acq_rel);
+    }
+
+    void notifyNotEmpty() {
+        if (Blocking) {
+            notEmpty.notify();
+        }
+    }
+
+    static ChunkPool& pool() {
+        static ChunkPool p;
+        return p;
+    }
+
+    static Chunk* acquireChunk() {
+        {
+            ChunkPool& p = pool();
+            std::lock_guard<std::mutex> lk(p.lock);
+            if (p.head != nullptr) {
+                Chunk* c = p.head;
+                p.head = c->next.load(std::memory_order_relaxed);
+                p.count--;
+                c->reset();
+                return c;
+            }
+        }
+        instrument::allocated<unbounded_mpmc_queue>("mpmc_queue", sizeof(Chunk));
+        return new Chunk();
+    }
+
+    // Returns a chunk (whose elements are all gone) to the pool - the epoch deleter.
+    static void recycleChunk(void* ptr) {
+        Chunk* c = static_cast<Chunk*>(ptr);
+        {
+            ChunkPool& p = pool();
+            std::lock_guard<std::mutex> lk(p.lock);
+            if (p.count < MAX_POOLED_CHUNKS) {
+                c->next.store(p.head, std::memory_order_relaxed);
+                p.head = c;
+                p.count++;
+                return;
+            }
+        }
+        deleteChunk(c);
+    }
+
+    static void deleteChunk(Chunk* c) {
+        instrument::freed<unbounded_mpmc_queue>("mpmc_queue", sizeof(Chunk));
+        delete c;
+    }
+};
+
+}; // end of 'rack'
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+
+namespace rack {
+
+//
+// Size-class slab pool for small, short-lived allocations (e.g. shared_ptr
+// control blocks).
+//
+// Requests are rounded up to a multiple of ALIGN and served from the size class
+// for that multiple, up to MAX_SIZE (anything larger goes to ::operator new).
+//
+// Each thread keeps an intrusive free list per size class, so the common
+// allocate/deallocate is a pop/push with no locking. Threads move memory to and
+// from a shared, per-class 'central' list a BATCH of blocks at a time:
+//      - an empty thread cache refills one batch from the central list, or
+//        carves a new batch from a SLAB_BYTES slab AND;
+//      - a thread cache holding 2 * BATCH blocks hands a batch back.
+//
+// So memory freed on a different thread from the one that allocated it (e.g.
+// producer/consumer) flows back through the central list in batches, rather
+// than one block - and one lock - at a time.
+//
+// NOTE: Slabs are never returned to the OS.
+//
+class slab_pool {
+public:
+    static constexpr size_t ALIGN = 16;
+    static constexpr size_t MAX_SIZE = 256;
+    static constexpr size_t N_CLASSES = MAX_SIZE / ALIGN;
+    static constexpr uint32_t BATCH = 32;
+    static constexpr size_t SLAB_BYTES = 64 * 1024;
+
+private:
+
+    struct FreeNode {
+        FreeNode* next;      // next block in this batch
+        FreeNode* nextBatch; // next batch (central list only)
+    };
+
+    struct Central {
+        std::mutex lock;
+        FreeNode* batches = nullptr;
+        char* slabCursor = nullptr;
+        char* slabEnd = nullptr;
+    };
+
+    struct ThreadCache {
+        FreeNode* head[N_CLASSES] = {};
+        uint32_t count[N_CLASSES] = {};
+
+        ~ThreadCache();
+    };
+
+    static Central central[N_CLASSES];
+
+    // Set once the calling thread's cache is destroyed (thread_local destructors
+    // run before any late frees, e.g. from statics) - fall back to the central list.
+    static inline thread_local bool cacheDead = false;
+
+    static ThreadCache& cache() {
+        thread_local ThreadCache c;
+        return c;
+    }
+
+public:
+
+    static void* allocate(size_t bytes) {
+        if (bytes > MAX_SIZE) {
+            return ::operator new(bytes);
+        }
+        size_t cls = sizeClass(bytes);
+
+        if (cacheDead) {
+            return refillOne(cls);
+        }
+
+        ThreadCache& c = cache();
+        if (c.head[cls] == nullptr) {
+            c.head[cls] = refill(cls, c.count[cls]);
+        }
+
+        FreeNode* n = c.head[cls];
+        c.head[cls] = n->next;
+        c.count[cls]--;
+        return n;
+    }
+
+    static void deallocate(void* p, size_t bytes) {
+        if (bytes > MAX_SIZE) {
+            ::operator delete(p);
+            return;
+        }
+        size_t cls = sizeClass(bytes);
+        FreeNode* n = static_cast<FreeNode*>(p);
+
+        if (cacheDead) {
+            n->next = nullptr;
+            giveBack(cls, n);
+            return;
+        }
+
+        ThreadCache& c = cache();
+        n->next = c.head[cls];
+        c.head[cls] = n;
+        c.count[cls]++;
+
+        // too much cached - hand a batch back to the central list
+        if (c.count[cls] >= 2 * BATCH) {
+            FreeNode* batch = c.head[cls];
+            FreeNode* last = batch;
+            for (uint32_t i = 1; i < BATCH; i++) {
+                last = last->next;
+            }
+            c.head[cls] = last->next;
+            c.count[cls] -= BATCH;
+            last->next = nullptr;
+            giveBack(cls, batch);
+        }
+    }
+
+    // Size class serving a request of `bytes` (<= MAX_SIZE).
+    static size_t sizeClass(size_t bytes) {
+        return bytes == 0 ? 0 : (bytes - 1) / ALIGN;
+    }
+
+private:
+
+    //
+    // Takes one batch from the central list for class `cls` (carving a new one if
+    // it's empty). Sets `count` to the number of blocks in it.
+    //
+    static FreeNode* refill(size_t cls, uint32_t& count) {
+        Central& ctr = central[cls];
+        std::lock_guard<std::mutex> lk(ctr.lock);
+
+        if (ctr.batches) {
+            FreeNode* batch = ctr.batches;
+            ctr.batches = batch->nextBatch;
+
+            count = 0;
+            for (FreeNode* n = batch; n; n = n->next) {
+                count++;
+            }
+            return batch;
+        }
+
+        count = BATCH;
+        return carve(ctr, cls, BATCH);
+    }
+
+    static void* refillOne(size_t cls) {
+        uint32_t count;
+        FreeNode* batch = refill(cls, count);
+        if (batch->next) {
+            giveBack(cls, batch->next);
+        }
+        return batch;
+    }
+
+    static void giveBack(size_t cls, FreeNode* batch) {
+        Central& ctr = central[cls];
+        std::lock_guard<std::mutex> lk(ctr.lock);
+        batch->nextBatch = ctr.batches;
+        ctr.batches = batch;
+    }
+
+    // Carves `n` fresh blocks from the current slab (caller holds `ctr.lock`).
+    static FreeNode* carve(Central& ctr, size_t cls, uint32_t n) {
+        size_t blockSize = (cls + 1) * ALIGN;
+
+        FreeNode* head = nullptr;
+        for (uint32_t i = 0; i < n; i++) {
+            if (ctr.slabCursor == nullptr || ctr.slabCursor + blockSize > ctr.slabEnd) {
+                ctr.slabCursor = static_cast<char*>(::operator new(SLAB_BYTES));
+                ctr.slabEnd = ctr.slabCursor + SLAB_BYTES;
+            }
+            FreeNode* node = reinterpret_cast<FreeNode*>(ctr.slabCursor);
+            ctr.slabCursor += blockSize;
+
+            node->next = head;
+            head = node;
+        }
+        return head;
+    }
+};
+
+inline slab_pool::Central slab_pool::central[slab_pool::N_CLASSES];
+
+// Thread exit - return everything cached to the central lists.
+inline slab_pool::ThreadCache::~ThreadCache() {
+    cacheDead = true;
+    for (size_t cls = 0; cls < N_CLASSES; cls++) {
+        if (head[cls]) {
+            giveBack(cls, head[cls]);
+            head[cls] = nullptr;
+            count[cls] = 0;
+        }
+    }
+}
+
+//////////////////////////////////////////////////////
+// Control block allocation
+//////////////////////////////////////////////////////
+
+//
+// Where shared_ptr control blocks come from - the `BlockAllocator` policy of
+// rack::shared_ptr. Defaults to slab_pool. Any type with static allocate() and
+// deallocate() like these will do. Being part of the pointer's type, a block is
+// always freed by the policy that made it.
+//
+struct pool_block_allocator {
+    static void* allocate(size_t bytes) {
+        return slab_pool::allocate(bytes);
+    }
+
+    static void deallocate(void* p, size_t bytes) {
+        slab_pool::deallocate(p, bytes);
+    }
+};
+
+struct new_delete_block_allocator {
+    static void* allocate(size_t bytes) {
+        return ::operator new(bytes);
+    }
+
+    static void deallocate(void* p, size_t) {
+        ::operator delete(p);
+    }
+};
+
+}; // end of 'rack'
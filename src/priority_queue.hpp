@@ -0,0 +1,414 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+
+#include "vector.hpp"
+
+namespace rack {
+
+namespace detail {
+
+//
+// Sift operations on an implicit D-ary heap held in an array - the children of
+// node i are D*i + 1 .. D*i + D, so a node's children sit next to each other
+// (D * sizeof(T) bytes - a cache line for 8-byte elements and D = 8), and the
+// tree is log_D(n) deep rather than log_2(n).
+//
+// Sifts move a 'hole' rather than swapping. `placed(node, i)` is called each
+// time a node lands at index i (used by indexed_priority_queue to track
+// positions - a no-op otherwise).
+//
+template <uint32_t D>
+struct dary_heap {
+    static_assert(D >= 2, "heap arity must be at least 2");
+
+    static uint32_t parent(uint32_t i) {
+        return (i - 1) / D;
+    }
+
+    template <class Node, class Less, class Placed>
+    static void siftUp(Node* h, uint32_t i, const Less& less, const Placed& placed) {
+        Node val = std::move(h[i]);
+        while (i > 0) {
+            uint32_t p = parent(i);
+            if (!less(h[p], val)) {
+                break;
+            }
+            h[i] = std::move(h[p]);
+            placed(h[i], i);
+            i = p;
+        }
+        h[i] = std::move(val);
+        placed(h[i], i);
+    }
+
+    template <class Node, class Less, class Placed>
+    static void siftDown(Node* h, uint32_t n, uint32_t i, const Less& less, const Placed& placed) {
+        Node val = std::move(h[i]);
+        while (true) {
+            uint32_t first = D * i + 1;
+            if (first >= n) {
+                break;
+            }
+
+            // highest priority child
+            uint32_t last = std::min(first + D, n);
+            uint32_t best = first;
+            for (uint32_t c = first + 1; c < last; c++) {
+                if (less(h[best], h[c])) {
+                    best = c;
+                }
+            }
+
+            if (!less(val, h[best])) {
+                break;
+            }
+            h[i] = std::move(h[best]);
+            placed(h[i], i);
+            i = best;
+        }
+        h[i] = std::move(val);
+        placed(h[i], i);
+    }
+
+    //
+    // Removes h[0] for pop - moves the hole straight down the highest priority
+    // children to a leaf (no compares against the replacement on the way), then
+    // sifts the last element up from there. It rarely climbs far, as the last
+    // element is usually near the bottom in priority too.
+    //
+    template <class Node, class Less, class Placed>
+    static void popRoot(Node* h, uint32_t n, const Less& less, const Placed& placed) {
+        uint32_t last = n - 1;
+        uint32_t i = 0;
+        while (true) {
+            uint32_t first = D * i + 1;
+            if (first >= last) {
+                break;
+            }
+            uint32_t end = std::min(first + D, last);
+            uint32_t best = first;
+            for (uint32_t c = first + 1; c < end; c++) {
+                if (less(h[best], h[c])) {
+                    best = c;
+                }
+            }
+            h[i] = std::move(h[best]);
+            placed(h[i], i);
+            i = best;
+        }
+        if (i != last) {
+            h[i] = std::move(h[last]);
+            siftUp(h, i, less, placed);
+        }
+    }
+
+    // Floyd's bottom-up build - O(n).
+    template <class Node, class Less, class Placed>
+    static void heapify(Node* h, uint32_t n, const Less& less, const Placed& placed) {
+        if (n < 2) {
+            return;
+        }
+        for (uint32_t i = parent(n - 1) + 1; i-- > 0;) {
+            siftDown(h, n, i, less, placed);
+        }
+    }
+};
+
+struct NoPlacement {
+    template <class Node>
+    void operator()(const Node&, uint32_t) const {}
+};
+
+}; // end of 'detail'
+
+//////////////////////////////////////////////////////
+// priority_queue
+//////////////////////////////////////////////////////
+
+//
+// D-ary heap over a rack::vector. As with std::priority_queue, top() is the
+// element that compares greatest under `Compare` (std::greater => a min-queue).
+//
+// A wider heap does fewer, more cache-friendly levels per pop (all D children
+// are compared together), at the cost of more compares per level. D = 4 or 8
+// is usually the sweet spot.
+//
+template <class T, class Compare = std::less<T>, uint32_t D = 4>
+class priority_queue {
+private:
+    using heap = detail::dary_heap<D>;
+
+    vector<T> _heap;
+    Compare comp;
+
+public:
+
+    //////////////////////////////////////////////////////
+    // Construtors
+    //////////////////////////////////////////////////////
+
+    priority_queue() {}
+
+    explicit priority_queue(const Compare& c)
+        : comp(c) {}
+
+    template <class It>
+    priority_queue(It first, It last, const Compare& c = Compare())
+        : comp(c) {
+        heapify(first, last);
+    }
+
+    //////////////////////////////////////////////////////
+    // Accessors
+    //////////////////////////////////////////////////////
+
+    const T& top() const {
+        return _heap.data()[0];
+    }
+
+    //////////////////////////////////////////////////////
+    // Modifiers
+    //////////////////////////////////////////////////////
+
+    void push(const T& val) {
+        _heap.push_back(val);
+        heap::siftUp(_heap.data(), _heap.size() - 1, comp, detail::NoPlacement());
+    }
+
+    void push(T&& val) {
+        _heap.push_back(std::move(val));
+        heap::siftUp(_heap.data(), _heap.size() - 1, comp, detail::NoPlacement());
+    }
+
+    template <class... Args>
+    void emplace(Args&&... args) {
+        _heap.emplace_back(std::forward<Args>(args)...);
+        heap::siftUp(_heap.data(), _heap.size() - 1, comp, detail::NoPlacement());
+    }
+
+    void pop() {
+        heap::popRoot(_heap.data(), _heap.size(), comp, detail::NoPlacement());
+        _heap.pop_back();
+    }
+
+    // Adds a range of elements, rebuilding the heap in O(n) rather than one push at a time.
+    template <class It>
+    void heapify(It first, It last) {
+        for (; first != last; ++first) {
+            _heap.push_back(*first);
+        }
+        heap::heapify(_heap.data(), _heap.size(), comp, detail::NoPlacement());
+    }
+
+    void clear() {
+        _heap.clear();
+    }
+
+    void reserve(uint32_t n) {
+        _heap.reserve(n);
+    }
+
+    //////////////////////////////////////////////////////
+    // Capacity
+    //////////////////////////////////////////////////////
+
+    bool empty() const { return _heap.empty(); }
+    uint32_t size() const { return _heap.size(); }
+};
+
+//////////////////////////////////////////////////////
+// indexed_priority_queue
+//////////////////////////////////////////////////////
+
+//
+// priority_queue whose elements can be reached after insertion, through the
+// handle push() returns - to change an element's priority (decrease_key(), as
+// in Dijkstra's algorithm) or erase() it, each in O(log n).
+//
+// Alongside the heap, a position table maps each handle to its element's
+// current index in the heap. Handles of popped/erased elements are reused.
+//
+template <class T, class Compare = std::less<T>, uint32_t D = 4>
+class indexed_priority_queue {
+public:
+    using handle = uint32_t;
+
+private:
+    using heap = detail::dary_heap<D>;
+
+    static constexpr uint32_t NPOS = static_cast<uint32_t>(-1);
+
+    struct Node {
+        T val;
+        handle h;
+    };
+
+    struct NodeLess {
+        Compare comp;
+        bool operator()(const Node& a, const Node& b) const { return comp(a.val, b.val); }
+    };
+
+    struct Placement {
+        uint32_t* pos;
+        void operator()(const Node& node, uint32_t i) const { pos[node.h] = i; }
+    };
+
+    vector<Node> _heap;
+    vector<uint32_t> pos;       // handle -> heap index (NPOS if free)
+    vector<handle> freeHandles;
+    NodeLess less;
+
+    Placement placement() {
+        return Placement{pos.data()};
+    }
+
+public:
+
+    //////////////////////////////////////////////////////
+    // Construtors
+    //////////////////////////////////////////////////////
+
+    indexed_priority_queue() {}
+
+    explicit indexed_priority_queue(const Compare& c)
+        : less{c} {}
+
+    //////////////////////////////////////////////////////
+    // Accessors
+    //////////////////////////////////////////////////////
+
+    const T& top() const {
+        return _heap.data()[0].val;
+    }
+
+    handle top_handle() const {
+        return _heap.data()[0].h;
+    }
+
+    // Whether `h` refers to an element still in the queue.
+    bool contains(handle h) const {
+        return h < pos.size() && pos.data()[h] != NPOS;
+    }
+
+    const T& value(handle h) const {
+        checkHandle(h);
+        return _heap.data()[pos.data()[h]].val;
+    }
+
+    //////////////////////////////////////////////////////
+    // Modifiers
+    //////////////////////////////////////////////////////
+
+    handle push(T val) {
+        handle h = newHandle();
+        _heap.push_back(Node{std::move(val), h});
+        heap::siftUp(_heap.data(), _heap.size() - 1, less, placement());
+        return h;
+    }
+
+    void pop() {
+        handle top = _heap.data()[0].h;
+        pos.data()[top] = NPOS;
+        freeHandles.push_back(top);
+
+        heap::popRoot(_heap.data(), _heap.size(), less, placement());
+        _heap.pop_back();
+    }
+
+    //
+    // Replaces `h`'s value, moving it towards the top. (Any change of value
+    // is handled - it's sifted whichever way it needs to go.)
+    //
+    void decrease_key(handle h, T val) {
+        checkHandle(h);
+        uint32_t i = pos.data()[h];
+        _heap.data()[i].val = std::move(val);
+        heap::siftUp(_heap.data(), i, less, placement());
+        heap::siftDown(_heap.data(), _heap.size(), pos.data()[h], less, placement());
+    }
+
+    void erase(handle h) {
+        checkHandle(h);
+        eraseAt(pos.data()[h]);
+    }
+
+    //
+    // Adds a range of elements, rebuilding the heap in O(n). Writes each new
+    // element's handle (in input order) to `handles`.
+    //
+    template <class It, class Out>
+    Out heapify(It first, It last, Out handles) {
+        for (; first != last; ++first) {
+            handle h = newHandle();
+            pos.data()[h] = _heap.size();
+            _heap.push_back(Node{*first, h});
+            *handles++ = h;
+        }
+        heap::heapify(_heap.data(), _heap.size(), less, placement());
+        return handles;
+    }
+
+    void clear() {
+        _heap.clear();
+        pos.clear();
+        freeHandles.clear();
+    }
+
+    void reserve(uint32_t n) {
+        _heap.reserve(n);
+        pos.reserve(n);
+    }
+
+    //////////////////////////////////////////////////////
+    // Capacity
+    //////////////////////////////////////////////////////
+
+    bool empty() const { return _heap.empty(); }
+    uint32_t size() const { return _heap.size(); }
+
+private:
+
+    handle newHandle() {
+        if (!freeHandles.empty()) {
+            handle h = freeHandles.back();
+            freeHandles.pop_back();
+            return h;
+        }
+        pos.push_back(NPOS);
+        return pos.size() - 1;
+    }
+
+    void checkHandle(handle h) const {
+        if (!contains(h)) {
+            throw std::runtime_error("Invalid handle: " + std::to_string(h));
+        }
+    }
+
+    // Fills index `i` with the last element, and sifts that into place.
+    void eraseAt(uint32_t i) {
+        Node* h = _heap.data();
+        uint32_t last = _heap.size() - 1;
+
+        pos.data()[h[i].h] = NPOS;
+        freeHandles.push_back(h[i].h);
+
+        if (i != last) {
+            h[i] = std::move(h[last]);
+        }
+        _heap.pop_back();
+
+        // the moved element may belong above or below `i`
+        if (i < last) {
+            handle moved = h[i].h;
+            heap::siftUp(h, i, less, placement());
+            heap::siftDown(h, last, pos.data()[moved], less, placement());
+        }
+    }
+};
+
+}; // end of 'rack'
@@ -0,0 +1,287 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace rack {
+
+//
+// Reference counting policies for shared_ptr's control block. The control block
+// derives from the policy, which provides:
+//      - a constructor taking the block's destroy function, starting the count at 1;
+//      - increment() AND;
+//      - decrement(), returning true if the caller dropped the last reference
+//        and must destroy the block;
+//      - count(), the (approximate, if shared across threads) strong count AND;
+//      - reclaim(), which frees a control block once nothing references it.
+//
+
+//////////////////////////////////////////////////////
+// atomic_refcount
+//////////////////////////////////////////////////////
+
+//
+// Plain atomic counting - every copy and release is an atomic RMW.
+//
+class atomic_refcount {
+public:
+    std::atomic<uint32_t> strongCnt;
+
+    // `destroy` unused - blocks are always freed by the releasing shared_ptr
+    explicit atomic_refcount(void (*)(atomic_refcount*))
+        : strongCnt(1) {}
+
+    void increment() {
+        strongCnt.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // acq_rel so the last owner sees every other owner's writes before deleting
+    bool decrement() {
+        return strongCnt.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+
+    uint32_t count() const {
+        return strongCnt.load(std::memory_order_relaxed);
+    }
+
+    template <class Block>
+    static void reclaim(Block* cb) {
+        delete cb;
+    }
+};
+
+//////////////////////////////////////////////////////
+// biased_refcount
+//////////////////////////////////////////////////////
+
+class biased_refcount;
+
+//
+// Per-thread state for biased reference counting - the queue of blocks this
+// thread owns that other threads have asked it to merge.
+//
+class brc_thread {
+private:
+    // Marks the queue of a thread that has exited
+    static inline biased_refcount* const DEAD = reinterpret_cast<biased_refcount*>(1);
+
+    std::atomic<biased_refcount*> queue{nullptr};
+
+    // Blocks created by this thread that are not yet merged (owner-only)
+    uint64_t ownedBlocks = 0;
+
+    // After exit, blocks still awaiting a merge. The state is freed when this hits zero.
+    std::atomic<int64_t> orphans{0};
+
+    struct Handle {
+        brc_thread* state = new brc_thread();
+        ~Handle() { state->exit(); }
+    };
+
+    friend class biased_refcount;
+
+public:
+    static brc_thread* current() {
+        thread_local Handle handle;
+        return handle.state;
+    }
+
+    // Merges every block other threads have queued for this thread.
+    void collect();
+
+private:
+    bool enqueue(biased_refcount* rc);
+    void drain(biased_refcount* list);
+    void releaseOrphan();
+    void exit();
+};
+
+//
+// Biased reference counting.
+//
+// Most shared_ptrs are only ever copied and dropped by the thread that created
+// them. So the creating ('owner') thread counts on a non-atomic 'biased'
+// count, and every other thread counts on an atomic 'shared' count. The
+// object is alive while biased + shared > 0.
+//
+// When the owner's biased count hits zero, it 'merges' - folding ownership into
+// the shared count, which from then on is the only count used (by every thread).
+//
+// Other threads can drive the shared count negative, e.g. by dropping a copy
+// the owner handed them. If that happens the block is 'queued' on the owner,
+// which merges it at its next collect(): on creating another biased block, at
+// thread exit, or on an explicit rack::brc_collect(). If the owner has already
+// exited, the queueing thread merges the block itself.
+//
+// NOTE: A block queued for merging is not freed until its owner collects, so a
+//       long-lived thread that stops creating shared_ptrs should call
+//       rack::brc_collect() periodically.
+//
+class biased_refcount {
+private:
+    // shared word layout - (count << 2) | QUEUED | MERGED
+    static constexpr int64_t MERGED = 1;
+    static constexpr int64_t QUEUED = 2;
+    static constexpr int64_t ONE = 4;
+
+    brc_thread* owner;
+    std::atomic<uint32_t> biased; // owner-only writes; atomic so count() may read it anywhere
+    std::atomic<int64_t> shared;
+    biased_refcount* nextQueued;
+    void (*destroy)(biased_refcount*);
+
+    friend class brc_thread;
+
+public:
+    explicit biased_refcount(void (*destroyFn)(biased_refcount*))
+        : owner(brc_thread::current()), biased(1), shared(0),
+          nextQueued(nullptr), destroy(destroyFn) {
+        owner->ownedBlocks++;
+        owner->collect();
+    }
+
+    void increment() {
+        uint32_t b = biased.load(std::memory_order_relaxed);
+        if (b > 0 && owner == brc_thread::current()) {
+            biased.store(b + 1, std::memory_order_relaxed); // plain load/store - no RMW
+            return;
+        }
+        shared.fetch_add(ONE, std::memory_order_relaxed);
+    }
+
+    bool decrement() {
+        uint32_t b = biased.load(std::memory_order_relaxed);
+        if (b > 0 && owner == brc_thread::current()) {
+            biased.store(b - 1, std::memory_order_relaxed);
+            if (b > 1) {
+                return false;
+            }
+
+            // biased count hit zero - merge into the shared count
+            int64_t next = shared.fetch_add(MERGED, std::memory_order_acq_rel) + MERGED;
+            if (next & QUEUED) {
+                return false; // the pending queue merge frees (and accounts for) the block
+            }
+            owner->ownedBlocks--;
+            return (next >> 2) == 0;
+        }
+
+        int64_t old = shared.load(std::memory_order_relaxed);
+        int64_t next;
+        do {
+            next = old - ONE;
+            if (!(old & MERGED) && (next >> 2) < 0) {
+                next |= QUEUED;
+            }
+        } while (!shared.compare_exchange_weak(old, next, std::memory_order_acq_rel,
+                                                         std::memory_order_relaxed));
+
+        if (next & MERGED) {
+            return (next >> 2) == 0 && !(next & QUEUED);
+        }
+
+        // we made the shared count negative - ask the owner to merge
+        if ((next & QUEUED) && !(old & QUEUED)) {
+            brc_thread* o = owner;
+            if (!o->enqueue(this)) {
+                mergeQueued(); // owner has exited - merge it ourselves
+                o->releaseOrphan();
+            }
+        }
+        return false;
+    }
+
+    uint32_t count() const {
+        int64_t s = shared.load(std::memory_order_relaxed) >> 2;
+        return static_cast<uint32_t>(biased.load(std::memory_order_relaxed) + s);
+    }
+
+    template <class Block>
+    static void reclaim(Block* cb) {
+        delete cb;
+    }
+
+private:
+    //
+    // Folds the biased count into the shared count and clears QUEUED, freeing
+    // the block if nothing references it.
+    //
+    // A queued block stays counted in its owner's ownedBlocks until this runs,
+    // even if the owner merged it normally in the meantime. That keeps the
+    // owner's state alive for a late enqueue().
+    //
+    void mergeQueued() {
+        uint32_t b = biased.load(std::memory_order_relaxed);
+        biased.store(0, std::memory_order_relaxed);
+
+        int64_t old = shared.load(std::memory_order_relaxed);
+        int64_t next;
+        do {
+            next = ((old & ~QUEUED) + (static_cast<int64_t>(b) << 2)) | MERGED;
+        } while (!shared.compare_exchange_weak(old, next, std::memory_order_acq_rel,
+                                                         std::memory_order_relaxed));
+
+        if ((next >> 2) == 0) {
+            destroy(this);
+        }
+    }
+};
+
+//////////////////////////////////////////////////////
+// brc_thread
+//////////////////////////////////////////////////////
+
+inline void brc_thread::collect() {
+    if (queue.load(std::memory_order_relaxed) == nullptr) {
+        return;
+    }
+    drain(queue.exchange(nullptr, std::memory_order_acquire));
+}
+
+// Returns false if this thread has exited.
+inline bool brc_thread::enqueue(biased_refcount* rc) {
+    biased_refcount* head = queue.load(std::memory_order_acquire);
+    do {
+        if (head == DEAD) {
+            return false;
+        }
+        rc->nextQueued = head;
+    } while (!queue.compare_exchange_weak(head, rc, std::memory_order_release,
+                                                    std::memory_order_acquire));
+    return true;
+}
+
+inline void brc_thread::drain(biased_refcount* list) {
+    while (list) {
+        biased_refcount* next = list->nextQueued; // `list` may be freed by the merge
+        list->mergeQueued();
+        ownedBlocks--;
+        list = next;
+    }
+}
+
+inline void brc_thread::releaseOrphan() {
+    if (orphans.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete this;
+    }
+}
+
+//
+// Called at thread exit. Closes the queue, merges what's in it, and hands the
+// remaining (unmerged) blocks over to whichever threads later queue them.
+//
+inline void brc_thread::exit() {
+    drain(queue.exchange(DEAD, std::memory_order_acq_rel));
+
+    int64_t remaining = static_cast<int64_t>(ownedBlocks);
+    if (orphans.fetch_add(remaining, std::memory_order_acq_rel) + remaining == 0) {
+        delete this;
+    }
+}
+
+// Merges any biased blocks other threads have queued for the calling thread.
+inline void brc_collect() {
+    brc_thread::current()->collect();
+}
+
+}; // end of 'rack'
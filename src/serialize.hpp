@@ -0,0 +1,247 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "deque.hpp"
+#include "vector.hpp"
+
+namespace rack {
+
+//
+// Binary serialization of containers of trivially copyable elements, over a
+// POSIX file descriptor (file, pipe or socket).
+//
+// The format is a fixed header followed by the raw element bytes, in order:
+//
+//      magic   u32   'RACK' - also catches a byte order mismatch
+//      version u16
+//      hdrSize u16   bytes in the header (so later versions can extend it)
+//      elemSize u32  sizeof(T) when written
+//      reserved u32
+//      count   u64   number of elements
+//
+// It's the same for every container, so a vector can be read back as a deque
+// and vice versa. Elements are written in native byte order - it's a format
+// for shipping between like machines, not for archiving.
+//
+// Writes are zero-copy - the header and the element memory itself (the vector
+// buffer, or each deque chunk's run) go out in writev() calls. Reads stream
+// in chunks straight into the container's storage. The header's count is
+// only trusted up to RESERVE_LIMIT bytes of up-front allocation - past that,
+// storage grows as the bytes arrive - so a stream claiming far more than it
+// holds can't force a huge allocation. On any error, the container is left
+// empty (a vector's buffer freed).
+//
+namespace serialize {
+
+constexpr uint32_t MAGIC = 0x4b434152; // "RACK" in little-endian byte order
+constexpr uint16_t VERSION = 1;
+
+struct header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t hdrSize;
+    uint32_t elemSize;
+    uint32_t reserved;
+    uint64_t count;
+};
+static_assert(sizeof(header) == 24, "header must have no padding");
+
+// Largest single read() - keeps a huge read interleaved with a producer on a pipe/socket.
+constexpr size_t READ_CHUNK = 1 << 20;
+
+// Most a vector read allocates before the bytes to fill it have arrived.
+constexpr size_t RESERVE_LIMIT = 64 * READ_CHUNK;
+
+namespace detail {
+
+[[noreturn]] inline void fail(const std::string& what) {
+    throw std::runtime_error("Serialization error: " + what);
+}
+
+[[noreturn]] inline void failErrno(const char* call) {
+    fail(std::string(call) + " failed: " + std::strerror(errno));
+}
+
+//
+// Writes every byte of `iov[0..n)`, resuming after partial writes and
+// splitting at IOV_MAX. Modifies `iov`.
+//
+inline void writeAll(int fd, struct iovec* iov, size_t n) {
+    while (n > 0) {
+        ssize_t written = ::writev(fd, iov, static_cast<int>(std::min<size_t>(n, IOV_MAX)));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            failErrno("writev");
+        }
+
+        // skip what went out
+        size_t left = static_cast<size_t>(written);
+        while (n > 0 && left >= iov->iov_len) {
+            left -= iov->iov_len;
+            iov++;
+            n--;
+        }
+        if (n > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+            iov->iov_len -= left;
+        }
+    }
+}
+
+// Reads exactly `len` bytes into `dst`, READ_CHUNK at a time.
+inline void readAll(int fd, void* dst, size_t len) {
+    char* p = static_cast<char*>(dst);
+    while (len > 0) {
+        ssize_t got = ::read(fd, p, std::min(len, READ_CHUNK));
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            failErrno("read");
+        }
+        if (got == 0) {
+            fail("unexpected end of stream");
+        }
+        p += got;
+        len -= static_cast<size_t>(got);
+    }
+}
+
+template <class T>
+header makeHeader(uint64_t count) {
+    header h;
+    h.magic = MAGIC;
+    h.version = VERSION;
+    h.hdrSize = sizeof(header);
+    h.elemSize = sizeof(T);
+    h.reserved = 0;
+    h.count = count;
+    return h;
+}
+
+// Reads and validates a header. Returns the element count.
+template <class T>
+uint64_t readHeader(int fd) {
+    header h;
+    readAll(fd, &h, sizeof(h));
+    if (h.magic != MAGIC) {
+        fail("bad magic (not a rack stream, or written with the other byte order)");
+    }
+    if (h.version != VERSION || h.hdrSize != sizeof(header)) {
+        fail("unsupported version " + std::to_string(h.version));
+    }
+    if (h.elemSize != sizeof(T)) {
+        fail("element size mismatch: stream=" + std::to_string(h.elemSize) +
+             ", expected=" + std::to_string(sizeof(T)));
+    }
+    if (h.count > UINT32_MAX) {
+        fail("element count too large: " + std::to_string(h.count));
+    }
+    return h.count;
+}
+
+template <class T>
+void checkElement() {
+    static_assert(std::is_trivially_copyable<T>::value, "serialization needs a trivially copyable T");
+}
+
+}; // end of 'detail'
+
+//////////////////////////////////////////////////////
+// vector
+//////////////////////////////////////////////////////
+
+// Writes `v` to `fd` - the header and the buffer in one writev().
+template <class T>
+void write(int fd, const vector<T>& v) {
+    detail::checkElement<T>();
+    header h = detail::makeHeader<T>(v.size());
+    struct iovec iov[2] = {
+        {&h, sizeof(h)},
+        {const_cast<T*>(v.data()), sizeof(T) * v.size()},
+    };
+    detail::writeAll(fd, iov, v.size() > 0 ? 2 : 1);
+}
+
+//
+// Replaces the contents of `v` with a container read from `fd`. Reserves
+// for the whole count (up to RESERVE_LIMIT), then appends READ_CHUNK bytes
+// at a time.
+//
+template <class T>
+void read(int fd, vector<T>& v) {
+    detail::checkElement<T>();
+    v.clear();
+    uint64_t count = detail::readHeader<T>(fd);
+    const uint64_t step = std::max<size_t>(1, READ_CHUNK / sizeof(T));
+    try {
+        v.reserve(static_cast<uint32_t>(std::min<uint64_t>(count, RESERVE_LIMIT / sizeof(T))));
+        for (uint64_t left = count; left > 0;) {
+            uint32_t n = static_cast<uint32_t>(std::min(left, step));
+            v.append_uninitialized(n, [fd](T* dst, uint32_t k) {
+                detail::readAll(fd, dst, sizeof(T) * k);
+            });
+            left -= n;
+        }
+    } catch (...) {
+        vector<T>().swap(v);
+        throw;
+    }
+}
+
+//////////////////////////////////////////////////////
+// deque
+//////////////////////////////////////////////////////
+
+//
+// Writes `d` to `fd` - the header, then one iovec per chunk's run of
+// elements, IOV_MAX to a writev().
+//
+template <class T>
+void write(int fd, const deque<T>& d) {
+    detail::checkElement<T>();
+    header h = detail::makeHeader<T>(d.size());
+
+    vector<struct iovec> iov;
+    iov.push_back({&h, sizeof(h)});
+    d.for_each_segment([&](const T* first, uint32_t count) {
+        iov.push_back({const_cast<T*>(first), sizeof(T) * count});
+    });
+    detail::writeAll(fd, iov.data(), iov.size());
+}
+
+//
+// Replaces the contents of `d` with a container read from `fd`. Each chunk
+// is filled by reads straight into it.
+//
+template <class T>
+void read(int fd, deque<T>& d) {
+    detail::checkElement<T>();
+    d.clear();
+    uint64_t count = detail::readHeader<T>(fd);
+    try {
+        d.append_uninitialized(static_cast<uint32_t>(count), [fd](T* dst, uint32_t n) {
+            detail::readAll(fd, dst, sizeof(T) * n);
+        });
+    } catch (...) {
+        d.clear();
+        throw;
+    }
+}
+
+}; // end of 'serialize'
+
+}; // end of 'rack'
@@ -1,22 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+#include "instrument.hpp"
+#include "pool.hpp"
+#include "refcount.hpp"
+
 namespace rack {
 
 template <class T>
+class atomic_shared_ptr;
+
+//
+// `RefCount` picks how the strong count is kept (see refcount.hpp):
+//      - atomic_refcount (default) - an atomic RMW per copy/release;
+//      - biased_refcount - non-atomic counting on the creating thread.
+//
+// `BlockAllocator` picks where control blocks come from (see pool.hpp):
+//      - pool_block_allocator (default) - a slab pool;
+//      - new_delete_block_allocator - plain ::operator new/delete.
+//
+template <class T, class RefCount = atomic_refcount, class BlockAllocator = pool_block_allocator>
 class shared_ptr {
 private:
 
-    // control block shared by each shared_ptr referencing `ptr`
-    struct SharedPtrControlBlock {
+    //
+    // Control block shared by each shared_ptr referencing `ptr`.
+    //
+    // The strong count comes from the `RefCount` base. The block also keeps its
+    // own copy of the managed pointer, which lets a bare control block pointer
+    // stand in for a whole shared_ptr (this is what atomic_shared_ptr stores).
+    //
+    // Blocks are allocated through `BlockAllocator`.
+    //
+    struct SharedPtrControlBlock : RefCount {
+
+        std::atomic<uint32_t> weakCnt;
+        T* ptr;
 
-        uint32_t strongCnt;
-        uint32_t weakCnt;
+        SharedPtrControlBlock(T* p)
+            : RefCount(&destroyBlock), weakCnt(0), ptr(p) {}
 
-        SharedPtrControlBlock()
-            : strongCnt(0), weakCnt(0) {}
+        static void* operator new(size_t bytes) {
+            instrument::allocated<shared_ptr>("shared_ptr", bytes);
+            return BlockAllocator::allocate(bytes);
+        }
+
+        static void operator delete(void* p, size_t bytes) {
+            instrument::freed<shared_ptr>("shared_ptr", bytes);
+            BlockAllocator::deallocate(p, bytes);
+        }
     };
 
     T* ptr;
     SharedPtrControlBlock* controlBlock;
 
+    template <class U>
+    friend class atomic_shared_ptr;
+
 public:
 
     //////////////////////////////////////////////////////
@@ -30,8 +73,7 @@ public:
 
     shared_ptr(T* p) {
         ptr = p;
-        controlBlock = new SharedPtrControlBlock();
-        controlBlock->strongCnt++;
+        controlBlock = new SharedPtrControlBlock(p);
     }
 
     ~shared_ptr() {
@@ -42,28 +84,49 @@ public:
     shared_ptr(const shared_ptr& other) {
         ptr = other.ptr;
         controlBlock = other.controlBlock;
-        controlBlock->strongCnt++;
+        if (controlBlock) {
+            controlBlock->increment();
+        }
     }
 
     // Move constructor
-    shared_ptr(const shared_ptr&& other) {
-
+    shared_ptr(shared_ptr&& other) noexcept {
+        ptr = other.ptr;
+        controlBlock = other.controlBlock;
+        other.ptr = nullptr;
+        other.controlBlock = nullptr;
     }
 
     // Copy assignment
-    shared_ptr<T>& operator=(const shared_ptr<T>& other) {
+    shared_ptr& operator=(const shared_ptr& other) {
+        if (this == &other) {
+            return *this;
+        }
         reset();
 
         ptr = other.ptr;
         controlBlock = other.controlBlock;
         if (controlBlock) { // `other` could be a null shared_ptr (perfectly valid)
-            controlBlock->strongCnt++;
+            controlBlock->increment();
         }
 
         return *this;
     }
 
-    // TODO: move assignment
+    // Move assignment
+    shared_ptr& operator=(shared_ptr&& other) noexcept {
+        if (this == &other) {
+            return *this;
+        }
+        reset();
+
+        ptr = other.ptr;
+        controlBlock = other.controlBlock;
+        other.ptr = nullptr;
+        other.controlBlock = nullptr;
+
+        return *this;
+    }
 
     //////////////////////////////////////////////////////
     // Modifiers
@@ -77,38 +140,40 @@ public:
 
     void reset(T* newPtr) {
         release();
+        ptr = nullptr;
+        controlBlock = nullptr;
         if (newPtr) {
             ptr = newPtr;
-            controlBlock = new SharedPtrControlBlock();
-            controlBlock->strongCnt++;
+            controlBlock = new SharedPtrControlBlock(newPtr);
         }
     }
 
-    // Swap pointers to managed object with `other`.
+    // Swap pointers to managed object (and their control blocks) with `other`.
     void swap(shared_ptr& other) {
         std::swap(ptr, other.ptr);
+        std::swap(controlBlock, other.controlBlock);
     }
 
     //////////////////////////////////////////////////////
     // Observers
     //////////////////////////////////////////////////////
 
-    T* get() {
+    T* get() const {
         return ptr;
     }
 
     T& operator*() const { return *ptr; }
     T* operator->()  const { return ptr; }
 
-    uint32_t use_count() {
+    uint32_t use_count() const {
         if (controlBlock == nullptr) {
             return 0;
         }
-        return controlBlock->strongCnt;
+        return controlBlock->count();
     }
 
-    bool unique() {
-        return controlBlock && controlBlock->strongCnt == 1;
+    bool unique() const {
+        return controlBlock && use_count() == 1;
     }
 
     operator bool() const {
@@ -128,23 +193,31 @@ private:
             return; 
         }
 
-        controlBlock->strongCnt--;
-        if (controlBlock->strongCnt == 0) {
+        if (controlBlock->decrement()) {
+            destroyBlock(controlBlock);
+        }
+    }
+
+    //
+    // Frees the managed object, and the control block if no non-owning references
+    // remain. Called with no owning references left - either by release(), or by
+    // the refcount policy itself (e.g. a deferred biased merge).
+    //
+    static void destroyBlock(RefCount* rc) {
+        SharedPtrControlBlock* cb = static_cast<SharedPtrControlBlock*>(rc);
 
-            // no owning references left - free managed object
-            delete ptr;
+        delete cb->ptr;
 
-            // also no non-owning references left - free control block
-            if (controlBlock->weakCnt == 0) {
-                delete controlBlock;
-            }
+        if (cb->weakCnt.load(std::memory_order_acquire) == 0) {
+            RefCount::reclaim(cb);
         }
     }
 };
 
-template <class T, typename... Args>
-shared_ptr<T> make_shared(Args&&... args) {
-    return shared_ptr<T>(new T(std::forward<Args>(args)...));
+template <class T, class RefCount = atomic_refcount, class BlockAllocator = pool_block_allocator,
+          typename... Args>
+shared_ptr<T, RefCount, BlockAllocator> make_shared(Args&&... args) {
+    return shared_ptr<T, RefCount, BlockAllocator>(new T(std::forward<Args>(args)...));
 }
 
 }; // end of 'rack'
@@ -0,0 +1,325 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "instrument.hpp"
+#include "vector.hpp"
+
+namespace rack {
+
+namespace detail {
+
+// Largest power of two chunk (at least 16 elements) that fits in a page.
+constexpr uint32_t defaultChunkBits(size_t elemSize) {
+    uint32_t bits = 4;
+    while ((size_t(1) << (bits + 1)) * elemSize <= 4096) {
+        bits++;
+    }
+    return bits;
+}
+
+}; // end of 'detail'
+
+//
+// Vector whose elements never move - pointers and references to them stay
+// valid across any number of appends (until the element is popped, or the
+// container cleared/destroyed).
+//
+// Like deque, elements live in fixed-size chunks, allocated as needed. Unlike
+// deque, it only grows at the back, and chunks are 2^ChunkBits elements, so
+// element i is chunks[i >> ChunkBits][i & mask] - a shift, a mask and two
+// loads. Growth appends a chunk pointer to the chunk index (a rack::vector,
+// which may reallocate - but it only ever moves the pointers).
+//
+// Iterators step a pointer through each chunk (as cheap as deque's). For bulk
+// work, for_each_segment() hands over each chunk's run as a plain array, so
+// the inner loop vectorises and runs at vector speed.
+//
+template <class T, uint32_t ChunkBits = detail::defaultChunkBits(sizeof(T))>
+class stable_vector {
+public:
+    static constexpr uint32_t CHUNK_SIZE = uint32_t(1) << ChunkBits;
+
+private:
+    static constexpr uint32_t MASK = CHUNK_SIZE - 1;
+
+    vector<T*> chunks;  // every allocated chunk - the first ceil(size / CHUNK_SIZE) in use
+    uint32_t _size;
+
+    std::allocator<T> elementAllocator;
+
+    //
+    // Forward iterator. Walks a pointer along the current chunk, moving to the
+    // next chunk only when it reaches the end of this one - the same per-step
+    // cost as a deque iterator.
+    //
+    // A position at the start of a chunk that isn't allocated (only ever the
+    // end, when size() is a multiple of CHUNK_SIZE) is a null `cur`.
+    //
+    template <bool Const>
+    class iter {
+    private:
+        using chunk_ptr = typename std::conditional<Const, T* const*, T**>::type;
+
+        T* cur;
+        T* last;            // end of cur's chunk
+        chunk_ptr node;     // cur's chunk in the chunk index
+        chunk_ptr nodeEnd;  // end of the chunk index
+
+        void setNode(chunk_ptr n) {
+            node = n;
+            cur = n < nodeEnd ? *n : nullptr;
+            last = cur ? cur + CHUNK_SIZE : nullptr;
+        }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = typename std::conditional<Const, const T*, T*>::type;
+        using reference = typename std::conditional<Const, const T&, T&>::type;
+
+        iter(chunk_ptr chunks, uint32_t numChunks, uint32_t idx)
+            : nodeEnd(chunks + numChunks) {
+            setNode(chunks + (idx >> ChunkBits));
+            if (cur) {
+                cur += idx & MASK;
+            }
+        }
+
+        // iterator -> const_iterator
+        template <bool C = Const, typename std::enable_if<C, int>::type = 0>
+        iter(const iter<false>& other)
+            : cur(other.cur), last(other.last), node(other.node), nodeEnd(other.nodeEnd) {}
+
+        reference operator*() const { return *cur; }
+        pointer operator->() const { return cur; }
+
+        iter& operator++() {
+            if (++cur == last) {
+                setNode(node + 1);
+            }
+            return *this;
+        }
+
+        iter operator++(int) {
+            iter tmp = *this;
+            ++*this;
+            return tmp;
+        }
+
+        bool operator==(const iter& other) const { return cur == other.cur; }
+        bool operator!=(const iter& other) const { return cur != other.cur; }
+
+        friend class iter<true>;
+    };
+
+public:
+    using value_type = T;
+    using iterator = iter<false>;
+    using const_iterator = iter<true>;
+
+    //////////////////////////////////////////////////////
+    // Construtors
+    //////////////////////////////////////////////////////
+
+    stable_vector()
+        : _size(0) {}
+
+    ~stable_vector() {
+        clear();
+        for (uint32_t c = 0; c < chunks.size(); c++) {
+            freeChunk(chunks.data()[c]);
+        }
+    }
+
+    stable_vector(const stable_vector& other)
+        : _size(0) {
+        reserve(other._size);
+        other.for_each_segment([&](const T* first, uint32_t count) {
+            for (uint32_t i = 0; i < count; i++) {
+                push_back(first[i]);
+            }
+        });
+    }
+
+    // (Moves the chunks over - references into `other` now refer into this.)
+    stable_vector(stable_vector&& other) noexcept
+        : chunks(std::move(other.chunks)), _size(other._size) {
+        other._size = 0;
+    }
+
+    stable_vector& operator=(const stable_vector& other) {
+        if (this != &other) {
+            stable_vector tmp(other);
+            swap(tmp);
+        }
+        return *this;
+    }
+
+    stable_vector& operator=(stable_vector&& other) noexcept {
+        if (this != &other) {
+            stable_vector tmp(std::move(other));
+            swap(tmp);
+        }
+        return *this;
+    }
+
+    void swap(stable_vector& other) noexcept {
+        chunks.swap(other.chunks);
+        std::swap(_size, other._size);
+    }
+
+    //////////////////////////////////////////////////////
+    // Accessors
+    //////////////////////////////////////////////////////
+
+    // Element `i` (unchecked)
+    T& operator [](uint32_t i) {
+        return chunks.data()[i >> ChunkBits][i & MASK];
+    }
+
+    const T& operator [](uint32_t i) const {
+        return chunks.data()[i >> ChunkBits][i & MASK];
+    }
+
+    // Element `i`, with bounds checking
+    T& at(uint32_t i) {
+        if (i >= _size) {
+            throw std::runtime_error(
+                "Index out of bounds error: " +
+                std::string("index=") + std::to_string(i) + ", size=" + std::to_string(_size)
+            );
+        }
+        return (*this)[i];
+    }
+
+    const T& at(uint32_t i) const {
+        return const_cast<stable_vector&>(*this).at(i);
+    }
+
+    T& front() {
+        return (*this)[0];
+    }
+
+    T& back() {
+        return (*this)[_size - 1];
+    }
+
+    //////////////////////////////////////////////////////
+    // Modifiers
+    //////////////////////////////////////////////////////
+
+    void push_back(const T& val) {
+        emplace_back(val);
+    }
+
+    void push_back(T&& val) {
+        emplace_back(std::move(val));
+    }
+
+    //
+    // Constructs an element at the back from `args`, allocating a new chunk
+    // if the last is full. Nothing already in the container moves.
+    //
+    template <typename... Args>
+    T& emplace_back(Args&&... args) {
+        if (_size == chunks.size() * CHUNK_SIZE) {
+            chunks.push_back(allocateChunk());
+        }
+        T* slot = &(*this)[_size];
+        new (slot) T(std::forward<Args>(args)...);
+        _size++;
+        return *slot;
+    }
+
+    void pop_back() {
+        _size--;
+        (*this)[_size].~T();
+    }
+
+    // Destroys every element. Chunks stay allocated.
+    void clear() {
+        for_each_segment([](T* first, uint32_t count) {
+            for (uint32_t i = 0; i < count; i++) {
+                first[i].~T();
+            }
+        });
+        _size = 0;
+    }
+
+    // Allocates chunks for `n` elements ahead of time.
+    void reserve(uint32_t n) {
+        uint32_t needed = (n + MASK) >> ChunkBits;
+        chunks.reserve(needed);
+        while (chunks.size() < needed) {
+            chunks.push_back(allocateChunk());
+        }
+    }
+
+    //////////////////////////////////////////////////////
+    // Iteration
+    //////////////////////////////////////////////////////
+
+    iterator begin() { return iterator(chunks.data(), chunks.size(), 0); }
+    iterator end() { return iterator(chunks.data(), chunks.size(), _size); }
+    const_iterator begin() const { return const_iterator(chunks.data(), chunks.size(), 0); }
+    const_iterator end() const { return const_iterator(chunks.data(), chunks.size(), _size); }
+
+    //
+    // Calls `fn(T* first, uint32_t count)` for each chunk's run of elements,
+    // front to back.
+    //
+    template <class Fn>
+    void for_each_segment(Fn fn) {
+        uint32_t left = _size;
+        for (uint32_t c = 0; left > 0; c++) {
+            uint32_t count = left < CHUNK_SIZE ? left : CHUNK_SIZE;
+            fn(chunks.data()[c], count);
+            left -= count;
+        }
+    }
+
+    template <class Fn>
+    void for_each_segment(Fn fn) const {
+        const_cast<stable_vector&>(*this).for_each_segment([&](T* first, uint32_t count) {
+            fn(static_cast<const T*>(first), count);
+        });
+    }
+
+    //////////////////////////////////////////////////////
+    // Capacity
+    //////////////////////////////////////////////////////
+
+    bool empty() const {
+        return _size == 0;
+    }
+
+    uint32_t size() const {
+        return _size;
+    }
+
+    uint32_t capacity() const {
+        return chunks.size() * CHUNK_SIZE;
+    }
+
+private:
+    T* allocateChunk() {
+        instrument::allocated<stable_vector>("stable_vector", sizeof(T) * CHUNK_SIZE);
+        return elementAllocator.allocate(CHUNK_SIZE);
+    }
+
+    void freeChunk(T* chunk) {
+        instrument::freed<stable_vector>("stable_vector", sizeof(T) * CHUNK_SIZE);
+        elementAllocator.deallocate(chunk, CHUNK_SIZE);
+    }
+};
+
+}; // end of 'rack'
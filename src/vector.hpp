@@ -1,16 +1,101 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <stdexcept>
+#include <utility>
 #include <sstream>
 #include <cassert>
 #include <iostream>
 
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "instrument.hpp"
+
 namespace rack {
 
+namespace detail {
+
+//
+// State of an in-progress incremental growth (see vector's `Incremental`):
+// elements [0, pending) still live in `old`, the rest in the new buffer.
+// Empty unless incremental, so an ordinary vector doesn't pay for it.
+//
+template <class T, bool Incremental>
+struct vector_growth {};
+
 template <class T>
-class vector {
+struct vector_growth<T, true> {
+    T* old = nullptr;
+    uint32_t oldCapacity = 0;
+    uint32_t pending = 0;
+    char* releasedFrom = nullptr; // old's pages from here up are already returned
+};
+
+//
+// Returns the whole pages within [first, last) to the OS (their contents are
+// dead). Lets a big buffer be given back a piece at a time - freeing it in
+// one go unmaps every page at once, which takes milliseconds. Returns where
+// the released run starts (`last`, if there was no whole page to release).
+//
+inline char* releasePages(char* first, char* last) {
+#ifdef __linux__
+    static const uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+    uintptr_t begin = (reinterpret_cast<uintptr_t>(first) + pageSize - 1) & ~(pageSize - 1);
+    uintptr_t end = reinterpret_cast<uintptr_t>(last) & ~(pageSize - 1);
+    if (begin < end) {
+        madvise(reinterpret_cast<void*>(begin), end - begin, MADV_DONTNEED);
+        return reinterpret_cast<char*>(begin);
+    }
+#else
+    (void)first;
+#endif
+    return last;
+}
+
+}; // end of 'detail'
+
+//
+// With Incremental = true, growth is de-amortised: rather than moving every
+// element in the push_back that fills the buffer, that push_back only
+// allocates the larger buffer, and each later push_back moves the next
+// GROWTH_STEP elements across (from the top down). Indexing reads from
+// whichever buffer holds the element. The migration finishes well before the
+// new buffer fills, so no single operation costs more than an allocation plus
+// a few element moves.
+//
+// data(), iterators and the operations that shift elements (insert, erase,
+// resize, reserve, append_uninitialized) need one buffer, so they finish any
+// pending migration first - that one call pays the remaining moves. A const
+// incremental vector can be read through operator[] and size(), but has no
+// data() (it can't finish a migration without modifying itself).
+//
+template <class T, bool Incremental = false>
+class vector : private detail::vector_growth<T, Incremental> {
+public:
+    // Elements moved to the new buffer per push_back while growing (Incremental only).
+    static constexpr uint32_t GROWTH_STEP = 4;
+
+    //
+    // Old buffers of at least RELEASE_MIN bytes are returned to the OS every
+    // RELEASE_RUN bytes migrated (Incremental only). Smaller ones are cheap to
+    // free in one go, and the allocator reuses them warm.
+    //
+    static constexpr size_t RELEASE_MIN = 4 * 1024 * 1024;
+    static constexpr size_t RELEASE_RUN = 64 * 1024;
+
 private:
     T* _buff;
     uint32_t _capacity;
     uint32_t _size;
 
+    using growth = detail::vector_growth<T, Incremental>;
+
 public:
 
     //////////////////////////////////////////////////////
@@ -23,7 +108,8 @@ public:
     }
 
     ~vector() {
-
+        clear();
+        freeBuffer(_buff, _capacity);
     }
 
     //
@@ -34,30 +120,55 @@ public:
     //
     vector(uint32_t n, T val) 
         : _capacity(n), _size(n) {
-        _buff = static_cast<T*>(::operator new(sizeof(T) * _capacity));
-        for (int i = 0; i < n; i++) {
-            _buff[i] = val;
+        _buff = allocateBuffer(_capacity);
+        for (uint32_t i = 0; i < n; i++) {
+            new (&_buff[i]) T(val);
         }
     }
 
     // Copy constructor (i.e. MyClass b = a, constructing b by copying a)
-    vector(const vector& other) {
-
+    vector(const vector& other)
+        : _buff(nullptr), _capacity(other._size), _size(other._size) {
+        if (_capacity > 0) {
+            _buff = allocateBuffer(_capacity);
+        }
+        for (uint32_t i = 0; i < _size; i++) {
+            new (&_buff[i]) T(*other.slot(i));
+        }
     }
 
     // Move constructor (i.e. MyClass b = std::move(a), constructing b by moving a)
-    vector(vector&& other) {
-
+    vector(vector&& other) noexcept
+        : growth(other), _buff(other._buff), _capacity(other._capacity), _size(other._size) {
+        static_cast<growth&>(other) = growth();
+        other._buff = nullptr;
+        other._capacity = 0;
+        other._size = 0;
     }
 
     // Copy assignment
     vector& operator=(const vector& other) {
-
+        if (this != &other) {
+            vector tmp(other);
+            swap(tmp);
+        }
+        return *this;
     }
 
     // Move assignment 
     vector& operator=(vector&& other) noexcept {
+        if (this != &other) {
+            vector tmp(std::move(other));
+            swap(tmp);
+        }
+        return *this;
+    }
 
+    void swap(vector& other) noexcept {
+        std::swap(static_cast<growth&>(*this), static_cast<growth&>(other));
+        std::swap(_buff, other._buff);
+        std::swap(_capacity, other._capacity);
+        std::swap(_size, other._size);
     }
 
     //////////////////////////////////////////////////////
@@ -72,24 +183,38 @@ public:
                 std::string("index=") + std::to_string(i) + ", size=" + std::to_string(_size)
             );
         }
-        return _buff[i];
+        return *slot(i);
+    }
+
+    const T& operator [](uint32_t i) const {
+        return const_cast<vector&>(*this)[i];
     }
 
     // First element of container
     T& front() { 
-        return _buff[0]; 
+        return *slot(0); 
     }
 
     // Last element of container
     T& back() {
-        return _buff[_size - 1]; 
+        return *slot(_size - 1); 
     }
 
     // Accesses pointer to underlying container
     T* data() { 
+        finishGrowth();
         return _buff; 
     }
 
+    //
+    // (Not for Incremental - a const vector may be mid-growth, and finishing
+    // it would modify the vector. Use the non-const data().)
+    //
+    template <bool I = Incremental, typename std::enable_if<!I, int>::type = 0>
+    const T* data() const {
+        return _buff;
+    }
+
     //////////////////////////////////////////////////////
     // Modifiers
     //////////////////////////////////////////////////////
@@ -99,71 +224,128 @@ public:
     // If capacity is reached, the container grows via a doubling strategy.
     //
     void push_back(const T& val) {
-        // first element added - allocate _buff of capacity 1
-        if (_capacity == 0) {
-            assert(_size == 0 && _buff == nullptr);
-            _capacity++;
-            _buff = static_cast<T*>(::operator new(sizeof(T) * _capacity));
-        }
+        emplace_back(val);
+    }
+
+    void push_back(T&& val) {
+        emplace_back(std::move(val));
+    }
 
-        // enough space for val
+    // Constructs element in place using `args` and performs 'push_back' operation
+    template <typename... Args>
+    void emplace_back(Args&&... args) {
+        // enough space for the new element
         if (_size < _capacity) {
-            new (&_buff[_size]) T(val); // note use of 'placement new' operator
+            new (&_buff[_size]) T(std::forward<Args>(args)...); // note use of 'placement new' operator
             _size++;
+            if constexpr (Incremental) {
+                migrate(GROWTH_STEP);
+            }
             return;
         }
 
         // 
-        // not enough space for val - grow the container
+        // not enough space - grow the container (first element added => capacity 1)
         //
+        uint32_t newCapacity = _capacity == 0 ? 1 : 2 * _capacity;
+        T* newBuffPtr = allocateBuffer(newCapacity);
 
-        // create new buffer of size 2n
-        T* newBuffPtr = static_cast<T*>(::operator new(sizeof(T) * 2 * _capacity));
+        // construct the new element first - `args` may refer to an element of the old buffer
+        new (&newBuffPtr[_size]) T(std::forward<Args>(args)...);
 
-        // copy n elements from old buffer into new buffer
-        for (int i = 0; i < _size; i++) {
-            new (&newBuffPtr[i]) T(_buff[i]);
+        if constexpr (Incremental) {
+            beginGrowth(newBuffPtr, newCapacity);
+        } else {
+            relocate(newBuffPtr, newCapacity);
         }
-        
-        // add val
-        new (&newBuffPtr[_size]) T(val);
         _size++;
-
-        //
-        // Teardown old buffer.
-        //
-        // Note that `::operator delete(_buff)` only de-allocates the memory buffer.
-        // We must also also destruct each object of the old array.
-        //
-        for (int i = 0; i < _size; ++i) {
-            _buff[i].~T();
-        }
-        ::operator delete(_buff);
-
-        // point _buff to new buffer
-        _buff = newBuffPtr;
-        _capacity = 2 * _capacity;
     }
 
-    // Constructs element in place using `args` and performs 'push_back' operation
-    template <typename... Args>
-    void emplace_back(Args&&... args) {
-
+    // Removes the last element
+    void pop_back() {
+        _size--;
+        slot(_size)->~T();
+        if constexpr (Incremental) {
+            if (this->pending > _size) {
+                this->pending = _size; // it was the top of the old buffer
+                migrate(0);
+            }
+        }
     }
 
     // Inserts copy of `val` before `pos`
     void insert(T val, uint32_t pos) {
+        if (pos > _size) {
+            throw std::runtime_error(
+                "Index out of bounds error: " +
+                std::string("index=") + std::to_string(pos) + ", size=" + std::to_string(_size)
+            );
+        }
 
+        // append, then rotate into place
+        emplace_back(std::move(val));
+        finishGrowth();
+        std::rotate(_buff + pos, _buff + _size - 1, _buff + _size);
     }
 
     // Erases element at `pos` from container
     void erase(uint32_t pos) {
+        erase(pos, pos + 1);
+    }
 
+    // Erases elements [first, last) from container
+    void erase(uint32_t first, uint32_t last) {
+        if (first > last || last > _size) {
+            throw std::runtime_error(
+                "Index out of bounds error: " +
+                std::string("range=[") + std::to_string(first) + ", " + std::to_string(last) +
+                "), size=" + std::to_string(_size)
+            );
+        }
+
+        // shift the tail down, then destroy the now moved-from end
+        finishGrowth();
+        std::move(_buff + last, _buff + _size, _buff + first);
+        for (uint32_t i = _size - (last - first); i < _size; i++) {
+            _buff[i].~T();
+        }
+        _size -= last - first;
     }
 
-    // Clears the contents of the container
-    void clear() {
+    //
+    // Appends `n` elements that `fill(T* dst, uint32_t n)` writes in place -
+    // e.g. straight from a read(2), with no staging copy. Only for trivially
+    // copyable T (any bytes written are a valid value). Nothing is appended if
+    // `fill` throws.
+    //
+    template <class Fn>
+    void append_uninitialized(uint32_t n, Fn fill) {
+        static_assert(std::is_trivially_copyable<T>::value, "append_uninitialized needs a trivially copyable T");
+        if (n > UINT32_MAX - _size) {
+            throw std::runtime_error(
+                "Size overflow error: " +
+                std::string("size=") + std::to_string(_size) + ", n=" + std::to_string(n)
+            );
+        }
+        finishGrowth();
+        if (_size + n > _capacity) {
+            uint64_t doubled = 2 * uint64_t(_capacity);
+            reserve(uint32_t(std::min<uint64_t>(std::max<uint64_t>(_size + n, doubled), UINT32_MAX)));
+        }
+        fill(_buff + _size, n);
+        _size += n;
+    }
 
+    // Clears the contents of the container (capacity is kept)
+    void clear() {
+        for (uint32_t i = 0; i < _size; ++i) {
+            slot(i)->~T();
+        }
+        if constexpr (Incremental) {
+            this->pending = 0;
+            migrate(0);
+        }
+        _size = 0;
     }
 
     //
@@ -174,27 +356,42 @@ public:
     // If `count` > size, additional copies of T() are appended.
     //
     void resize(uint32_t count) {
-
+        finishGrowth();
+        if (count < _size) {
+            erase(count, _size);
+            return;
+        }
+        reserve(count);
+        while (_size < count) {
+            new (&_buff[_size]) T();
+            _size++;
+        }
     }
 
     //////////////////////////////////////////////////////
     // Capacity
     //////////////////////////////////////////////////////
 
-    bool empty() {
+    bool empty() const {
         return _size == 0;
     }
 
-    uint32_t size() {
+    uint32_t size() const {
         return _size;
     }
 
-    uint32_t capacity() {
+    uint32_t capacity() const {
         return _capacity;
     }
 
     // Reserve capacity ahead of time.
-    void reserve(uint32_t capacity);
+    void reserve(uint32_t capacity) {
+        finishGrowth();
+        if (capacity <= _capacity) {
+            return;
+        }
+        relocate(allocateBuffer(capacity), capacity);
+    }
 
     //////////////////////////////////////////////////////
     // Display
@@ -206,7 +403,7 @@ public:
         oss << "[ ";
         for (uint32_t i = 0; i < _size; ++i) 
         {
-            oss << _buff[i];
+            oss << *slot(i);
             if (i != _size - 1) {
                 oss << ", ";
             }
@@ -265,11 +462,129 @@ public:
 
 
     iterator begin() {
-        return iterator(_buff);
+        return iterator(data());
     }
 
     iterator end() {
-        return iterator(_buff + _size);
+        return iterator(data() + _size);
+    }
+
+private:
+
+    // Where element `i` lives - the old buffer, if it hasn't been migrated yet.
+    T* slot(uint32_t i) const {
+        if constexpr (Incremental) {
+            if (i < this->pending) {
+                return &this->old[i];
+            }
+        }
+        return &_buff[i];
+    }
+
+    //
+    // Incremental growth - switches to `newBuff` (of `newCapacity`), leaving
+    // the elements in the current buffer to be migrated by later operations.
+    //
+    void beginGrowth(T* newBuff, uint32_t newCapacity) {
+        finishGrowth(); // (never pending here - migration outpaces filling)
+        if (_buff != nullptr) {
+            constexpr bool moved = std::is_nothrow_move_constructible<T>::value
+                                   || !std::is_copy_constructible<T>::value;
+            instrument::reallocated<vector>("vector", moved ? 0 : _size, moved ? _size : 0);
+        }
+        this->old = _buff;
+        this->oldCapacity = _capacity;
+        this->pending = _size;
+        bool release = sizeof(T) * size_t(_capacity) >= RELEASE_MIN;
+        this->releasedFrom = reinterpret_cast<char*>(_buff + (release ? _capacity : 0));
+        _buff = newBuff;
+        _capacity = newCapacity;
+        migrate(0); // frees an empty old buffer straight away
+    }
+
+    //
+    // Moves up to `count` of the pending elements (top down) into the new
+    // buffer, freeing the old one once it's empty (returning a big one's pages
+    // on the way, so the free itself is cheap). A throwing
+    // copy leaves the element it was copying in the old buffer.
+    //
+    void migrate(uint32_t count) {
+        if constexpr (Incremental) {
+            if (this->old == nullptr) {
+                return;
+            }
+            uint32_t stop = this->pending > count ? this->pending - count : 0;
+            while (this->pending > stop) {
+                uint32_t i = this->pending - 1;
+                new (&_buff[i]) T(std::move_if_noexcept(this->old[i]));
+                this->old[i].~T();
+                this->pending = i;
+            }
+            if (this->pending == 0) {
+                freeBuffer(this->old, this->oldCapacity);
+                this->old = nullptr;
+                this->oldCapacity = 0;
+                this->releasedFrom = nullptr;
+                return;
+            }
+            char* migratedFrom = reinterpret_cast<char*>(this->old + this->pending);
+            if (this->releasedFrom - migratedFrom >= ptrdiff_t(RELEASE_RUN)) {
+                this->releasedFrom = detail::releasePages(migratedFrom, this->releasedFrom);
+            }
+        }
+    }
+
+    // Completes any pending incremental growth, so every element is in `_buff`.
+    void finishGrowth() {
+        if constexpr (Incremental) {
+            migrate(this->pending);
+        }
+    }
+
+    //
+    // Moves the elements into `newBuff` (of `newCapacity`), and frees the old buffer.
+    //
+    // Elements are moved if that can't throw, otherwise copied, so a throwing copy
+    // leaves the old buffer intact.
+    //
+    void relocate(T* newBuff, uint32_t newCapacity) {
+        for (uint32_t i = 0; i < _size; i++) {
+            new (&newBuff[i]) T(std::move_if_noexcept(_buff[i]));
+        }
+        if (_buff != nullptr) {
+            constexpr bool moved = std::is_nothrow_move_constructible<T>::value
+                                   || !std::is_copy_constructible<T>::value;
+            instrument::reallocated<vector>("vector", moved ? 0 : _size, moved ? _size : 0);
+        }
+
+        //
+        // Teardown old buffer.
+        //
+        // Note that `freeBuffer()` only de-allocates the memory buffer.
+        // We must also also destruct each object of the old array.
+        //
+        for (uint32_t i = 0; i < _size; ++i) {
+            _buff[i].~T();
+        }
+        freeBuffer(_buff, _capacity);
+
+        // point _buff to new buffer
+        _buff = newBuff;
+        _capacity = newCapacity;
+    }
+
+    // Raw (unconstructed) storage for `capacity` elements.
+    static T* allocateBuffer(uint32_t capacity) {
+        instrument::allocated<vector>("vector", sizeof(T) * capacity);
+        return static_cast<T*>(::operator new(sizeof(T) * capacity));
+    }
+
+    static void freeBuffer(T* buff, uint32_t capacity) {
+        if (buff == nullptr) {
+            return;
+        }
+        instrument::freed<vector>("vector", sizeof(T) * capacity);
+        ::operator delete(buff);
     }
 };
 
@@ -1,13 +1,34 @@
 #include <iostream>
 #include <cassert>
 #include <cmath>
+#include <cstdio>
+#include <map>
+#include <queue>
+#include <set>
 #include <random> 
 #include <algorithm>
 #include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 #include "vector.hpp"
 #include "shared_ptr.hpp"
+#include "atomic_shared_ptr.hpp"
+#include "epoch.hpp"
+#include "pool.hpp"
 #include "deque.hpp"
+#include "instrument.hpp"
+#include "flat_hash_map.hpp"
+#include "flat_map.hpp"
+#include "priority_queue.hpp"
+#include "concurrent_vector.hpp"
+#include "bitvector.hpp"
+#include "serialize.hpp"
+#include "stable_vector.hpp"
+#include "mpmc_queue.hpp"
 
 class MyClass {
 public:
@@ -22,6 +43,18 @@ public:
 int MyClass::copyCtorCalls = 0;
 int MyClass::moveCtorCalls = 0;
 
+// Like MyClass, but its move constructor may throw
+class ThrowingMove {
+public:
+    int val;
+    static int copyCtorCalls;
+
+    ThrowingMove(int v) : val(v) {}
+    ThrowingMove(const ThrowingMove& other) : val(other.val) { ++copyCtorCalls; }
+    ThrowingMove(ThrowingMove&& other) : val(other.val) {}
+};
+int ThrowingMove::copyCtorCalls = 0;
+
 ////////////////////////////////////////
 // vector tests
 ////////////////////////////////////////
@@ -66,10 +99,9 @@ void vector_testPushBack() {
         int expectedCopyCount = copyCount;
         int expectedMoveCount = moveCount;
 
-        expectedMoveCount += 1; // 1 move into push_back
-        expectedCopyCount += 1; // 1 copy into buffer
-        if (vec2.capacity() == vec2.size()) { // resize required - n copies into new buffer
-            expectedCopyCount += vec2.size();
+        expectedMoveCount += 1; // 1 move into buffer
+        if (vec2.capacity() == vec2.size()) { // resize required - n (noexcept) moves into new buffer
+            expectedMoveCount += vec2.size();
         }
 
         MyClass m(i);
@@ -78,6 +110,23 @@ void vector_testPushBack() {
         assert(expectedCopyCount == copyCount);
         assert(expectedMoveCount == moveCount);
     }
+    for (int i = 0; i < n; i++) {
+        assert(vec2[i].val == i);
+    }
+
+    //
+    // a move that may throw is not used for a resize - elements are copied instead
+    //
+
+    rack::vector<ThrowingMove> vec3;
+    int copies = 0;
+    for (int i = 0; i < n; i++) {
+        if (vec3.capacity() == vec3.size()) {
+            copies += vec3.size();
+        }
+        vec3.push_back(ThrowingMove(i));
+    }
+    assert(ThrowingMove::copyCtorCalls == copies);
 }
 
 void vector_testIterate() {
@@ -134,6 +183,148 @@ void vector_testIterate() {
     assert(std::is_sorted(vec3.begin(), vec3.end()));
 }
 
+void vector_testModifiers() {
+    rack::vector<std::string> v;
+    v.reserve(10);
+    assert(v.capacity() == 10 && v.size() == 0);
+
+    for (int i = 0; i < 5; i++) {
+        v.emplace_back(3, 'a' + i); // "aaa", "bbb", ...
+    }
+    v.insert("xyz", 0);
+    v.insert("end", v.size());
+    // expect - [xyz, aaa, bbb, ccc, ddd, eee, end]
+    assert(v.size() == 7 && v[0] == "xyz" && v[1] == "aaa" && v[6] == "end");
+
+    v.erase(1);
+    v.erase(2, 4);
+    // expect - [xyz, bbb, eee, end]
+    assert(v.size() == 4 && v[1] == "bbb" && v[2] == "eee");
+
+    v.resize(6);
+    assert(v.size() == 6 && v[5].empty());
+    v.resize(2);
+    v.pop_back();
+    assert(v.size() == 1 && v.back() == "xyz");
+
+    // pushing an element of the vector itself, across a reallocation
+    rack::vector<std::string> w;
+    w.push_back("self");
+    w.push_back(w[0]);
+    w.push_back(w[1]);
+    assert(w.size() == 3 && w[2] == "self");
+
+    // growth moves (rather than copies) nothrow-movable elements
+    rack::vector<MyClass> m;
+    MyClass::copyCtorCalls = 0;
+    for (int i = 0; i < 100; i++) {
+        m.emplace_back(i);
+    }
+    assert(MyClass::copyCtorCalls == 0 && m[99].val == 99);
+
+    // appending past the maximum size throws (before allocating anything)
+    rack::vector<int> a(1, 0);
+    bool threw = false;
+    try {
+        a.append_uninitialized(UINT32_MAX, [](int*, uint32_t) {});
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw && a.size() == 1 && a.capacity() == 1);
+}
+
+// Whether `const V` has a data() accessor
+template <class V, class = void>
+struct hasConstData : std::false_type {};
+
+template <class V>
+struct hasConstData<V, std::void_t<decltype(std::declval<const V&>().data())>> : std::true_type {};
+
+void vector_testIncremental() {
+    // growth is spread over later pushes - elements read the same throughout
+    rack::vector<std::string, true> v;
+    for (int i = 0; i < 1000; i++) {
+        v.push_back(std::to_string(i));
+        assert(v.size() == uint32_t(i + 1) && v.back() == std::to_string(i));
+        if (i % 97 == 0) {
+            for (int j = 0; j <= i; j++) {
+                assert(v[j] == std::to_string(j));
+            }
+        }
+    }
+    assert(v.capacity() == 1024 && v.front() == "0");
+
+    // pops reach back into the old buffer mid-migration
+    rack::vector<std::string, true> p;
+    for (int i = 0; i < 65; i++) {
+        p.push_back(std::to_string(i)); // the 65th starts a growth - all 64 pending
+    }
+    for (int i = 0; i < 40; i++) {
+        p.pop_back();
+    }
+    p.push_back("x");
+    assert(p.size() == 26 && p[24] == "24" && p[25] == "x" && p[0] == "0");
+
+    // a const incremental vector reads mid-migration without modifying it (and
+    // has no data(), which would have to finish the migration)
+    static_assert(hasConstData<rack::vector<int>>::value, "");
+    static_assert(!hasConstData<rack::vector<int, true>>::value, "");
+    rack::vector<std::string, true> q;
+    for (int i = 0; i < 65; i++) {
+        q.push_back(std::to_string(i)); // mid-migration - 64 pending
+    }
+    const rack::vector<std::string, true>& cq = q;
+    for (uint32_t i = 0; i < cq.size(); i++) {
+        assert(cq[i] == std::to_string(i));
+    }
+    std::thread readers[2];
+    for (auto& t : readers) {
+        t = std::thread([&cq]() {
+            for (uint32_t i = 0; i < cq.size(); i++) {
+                assert(cq[i] == std::to_string(i));
+            }
+        });
+    }
+    for (auto& t : readers) {
+        t.join();
+    }
+    assert(q.capacity() == 128 && q[0] == "0");
+
+    // contiguous operations finish the migration first
+    rack::vector<int, true> w;
+    for (int i = 0; i < 129; i++) {
+        w.push_back(i);
+    }
+    int sum = 0;
+    for (int x : w) {
+        sum += x;
+    }
+    assert(sum == 128 * 129 / 2 && w.data()[100] == 100);
+    w.insert(-1, 0);
+    w.erase(5);
+    assert(w.size() == 129 && w[0] == -1 && w[5] == 5 && w[128] == 128);
+
+    // copy/move/clear mid-migration
+    rack::vector<std::string, true> a;
+    for (int i = 0; i < 33; i++) {
+        a.push_back(std::to_string(i));
+    }
+    rack::vector<std::string, true> b(a);
+    rack::vector<std::string, true> c(std::move(a));
+    assert(b.size() == 33 && b[3] == "3" && c.size() == 33 && c[3] == "3" && a.size() == 0);
+    c.clear();
+    c.push_back("y");
+    assert(c.size() == 1 && c[0] == "y");
+
+    // growth moves (rather than copies) nothrow-movable elements
+    rack::vector<MyClass, true> m;
+    MyClass::copyCtorCalls = 0;
+    for (int i = 0; i < 100; i++) {
+        m.emplace_back(i);
+    }
+    assert(MyClass::copyCtorCalls == 0 && m[0].val == 0 && m[99].val == 99);
+}
+
 ////////////////////////////////////////
 // shared_ptr tests
 ////////////////////////////////////////
@@ -178,6 +369,1522 @@ void shared_ptr_test() {
     assert(sp->val == val + 2);
 }
 
+// Tracks live instances, so tests can check nothing leaks or is freed twice.
+class Counted {
+public:
+    int val;
+    static std::atomic<int> alive;
+
+    Counted(int v) : val(v) { ++alive; }
+    Counted(const Counted& other) : val(other.val) { ++alive; }
+    Counted& operator=(const Counted& other) = default;
+    ~Counted() { --alive; }
+};
+std::atomic<int> Counted::alive{0};
+
+void atomic_shared_ptr_test() {
+    Counted::alive = 0;
+    {
+        rack::atomic_shared_ptr<Counted> asp;
+        assert(asp.is_lock_free());
+        assert(!asp.load());
+
+        rack::shared_ptr<Counted> sp = rack::make_shared<Counted>(1);
+        asp.store(sp);
+        assert(sp.use_count() == 2);
+
+        rack::shared_ptr<Counted> loaded = asp.load();
+        assert(loaded.get() == sp.get());
+        assert(sp.use_count() == 3);
+
+        // exchange hands back the slot's reference
+        rack::shared_ptr<Counted> old = asp.exchange(rack::make_shared<Counted>(2));
+        assert(old.get() == sp.get());
+        assert(sp.use_count() == 3);
+        assert(asp.load()->val == 2);
+
+        // failed compare_exchange refreshes `expected`
+        rack::shared_ptr<Counted> expected = sp;
+        assert(!asp.compare_exchange_strong(expected, rack::make_shared<Counted>(3)));
+        assert(expected->val == 2);
+
+        assert(asp.compare_exchange_strong(expected, rack::make_shared<Counted>(4)));
+        assert(asp.load()->val == 4);
+        assert(expected.use_count() == 1);
+
+        asp.store(rack::shared_ptr<Counted>());
+        assert(!asp.load());
+    }
+    assert(Counted::alive == 0);
+
+    //
+    // many readers, one writer - readers must only ever see fully published values
+    //
+    {
+        rack::atomic_shared_ptr<Counted> asp(rack::make_shared<Counted>(0));
+        std::atomic<bool> done{false};
+        const int nReaders = 4;
+        const int nWrites = 20000;
+
+        std::vector<std::thread> readers;
+        for (int r = 0; r < nReaders; r++) {
+            readers.emplace_back([&]() {
+                int last = 0;
+                while (!done.load(std::memory_order_acquire)) {
+                    rack::shared_ptr<Counted> sp = asp.load();
+                    assert(sp && sp->val >= last); // writer only publishes increasing values
+                    last = sp->val;
+                }
+            });
+        }
+
+        for (int i = 1; i <= nWrites; i++) {
+            if (i % 2) {
+                asp.store(rack::make_shared<Counted>(i));
+            } else {
+                rack::shared_ptr<Counted> expected = asp.load();
+                assert(asp.compare_exchange_strong(expected, rack::make_shared<Counted>(i)));
+            }
+        }
+        done.store(true, std::memory_order_release);
+        for (auto& t : readers) {
+            t.join();
+        }
+        assert(asp.load()->val == nWrites);
+    }
+    assert(Counted::alive == 0);
+}
+
+void biased_shared_ptr_test() {
+    using BiasedPtr = rack::shared_ptr<Counted, rack::biased_refcount>;
+    Counted::alive = 0;
+
+    // owner-only copies and releases
+    {
+        BiasedPtr sp = rack::make_shared<Counted, rack::biased_refcount>(1);
+        BiasedPtr sp1 = sp;
+        {
+            BiasedPtr sp2 = sp1;
+            assert(sp.use_count() == 3);
+        }
+        assert(sp.use_count() == 2);
+        sp1.reset();
+        assert(sp.unique());
+        assert(sp->val == 1);
+    }
+    assert(Counted::alive == 0);
+
+    // other threads copy and drop while the owner still holds a reference
+    {
+        BiasedPtr sp = rack::make_shared<Counted, rack::biased_refcount>(2);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++) {
+            threads.emplace_back([sp]() {
+                for (int i = 0; i < 10000; i++) {
+                    BiasedPtr copy = sp;
+                    assert(copy->val == 2);
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        assert(sp.unique());
+    }
+    // the threads' captured copies were made (biased) here but dropped there - merge them
+    rack::brc_collect();
+    assert(Counted::alive == 0);
+
+    // owner's only reference dropped on another thread - freed on the owner's collect
+    {
+        BiasedPtr sp = rack::make_shared<Counted, rack::biased_refcount>(3);
+        std::thread t([moved = std::move(sp)]() mutable {
+            moved.reset();
+        });
+        t.join();
+        assert(Counted::alive == 1);
+        rack::brc_collect();
+        assert(Counted::alive == 0);
+    }
+
+    // owner exits while others still hold references - last holder merges and frees
+    {
+        BiasedPtr held;
+        std::thread owner([&held]() {
+            BiasedPtr sp = rack::make_shared<Counted, rack::biased_refcount>(4);
+            held = sp;
+        });
+        owner.join();
+        assert(held->val == 4);
+
+        std::thread t([moved = std::move(held)]() mutable {
+            moved.reset();
+        });
+        t.join();
+        assert(Counted::alive == 0);
+    }
+}
+
+////////////////////////////////////////
+// epoch tests
+////////////////////////////////////////
+
+void epoch_test() {
+    Counted::alive = 0;
+
+    // retired objects are freed once the epoch moves on
+    for (int i = 0; i < 1000; i++) {
+        rack::epoch::retire(new Counted(i));
+    }
+    rack::epoch::synchronize();
+    assert(Counted::alive == 0);
+    assert(rack::epoch::pending() == 0);
+
+    // an open guard holds back anything retired while it is open
+    {
+        std::atomic<int> stage{0};
+        std::thread reader([&]() {
+            rack::epoch::guard g;
+            stage = 1;
+            while (stage != 2) {
+                std::this_thread::yield();
+            }
+        });
+        while (stage != 1) {
+            std::this_thread::yield();
+        }
+
+        rack::epoch::retire(new Counted(0));
+        for (int i = 0; i < 10; i++) {
+            rack::epoch::collect();
+        }
+        assert(Counted::alive == 1);
+
+        stage = 2;
+        reader.join();
+        rack::epoch::synchronize();
+        assert(Counted::alive == 0);
+    }
+
+    //
+    // stress - readers dereference the published node under a guard while
+    // writers replace and retire it
+    //
+    {
+        struct Node {
+            Counted c;
+            uint64_t magic;
+            Node(int v) : c(v), magic(0xfeedface) {}
+            ~Node() { magic = 0; }
+        };
+
+        std::atomic<Node*> published{new Node(0)};
+        std::atomic<bool> done{false};
+        std::vector<std::thread> threads;
+
+        for (int r = 0; r < 4; r++) {
+            threads.emplace_back([&]() {
+                while (!done.load(std::memory_order_acquire)) {
+                    rack::epoch::guard g;
+                    Node* n = published.load(std::memory_order_acquire);
+                    assert(n->magic == 0xfeedface);
+                }
+            });
+        }
+        for (int w = 0; w < 2; w++) {
+            threads.emplace_back([&]() {
+                for (int i = 0; i < 20000; i++) {
+                    Node* old = published.exchange(new Node(i), std::memory_order_acq_rel);
+                    rack::epoch::retire(old);
+                }
+            });
+        }
+
+        threads[4].join();
+        threads[5].join();
+        done = true;
+        for (int r = 0; r < 4; r++) {
+            threads[r].join();
+        }
+
+        // writers have exited, so their limbo is on the orphan list
+        rack::epoch::retire(published.load());
+        rack::epoch::synchronize();
+        assert(Counted::alive == 0);
+        assert(rack::epoch::pending() == 0);
+    }
+
+    // shared_ptr control blocks retired through the epoch
+    {
+        using EpochPtr = rack::shared_ptr<Counted, rack::epoch_refcount>;
+        EpochPtr sp = rack::make_shared<Counted, rack::epoch_refcount>(1);
+        EpochPtr sp1 = sp;
+        assert(sp.use_count() == 2);
+        sp.reset();
+        sp1.reset();
+        assert(Counted::alive == 0);           // object freed immediately
+        assert(rack::epoch::pending() == 1);   // control block deferred
+        rack::epoch::synchronize();
+        assert(rack::epoch::pending() == 0);
+    }
+}
+
+////////////////////////////////////////
+// pool tests
+////////////////////////////////////////
+
+void pool_test() {
+    // freed blocks are reused by the same thread
+    void* p = rack::slab_pool::allocate(24);
+    rack::slab_pool::deallocate(p, 24);
+    assert(rack::slab_pool::allocate(24) == p);
+    rack::slab_pool::deallocate(p, 24);
+
+    // blocks don't overlap, and sizes round to their class
+    std::vector<char*> blocks;
+    for (int i = 0; i < 1000; i++) {
+        char* b = static_cast<char*>(rack::slab_pool::allocate(40));
+        std::fill(b, b + 40, static_cast<char>(i));
+        blocks.push_back(b);
+    }
+    std::sort(blocks.begin(), blocks.end());
+    for (size_t i = 1; i < blocks.size(); i++) {
+        assert(blocks[i] - blocks[i - 1] >= 48);
+    }
+    for (char* b : blocks) {
+        rack::slab_pool::deallocate(b, 40);
+    }
+    assert(rack::slab_pool::sizeClass(1) == rack::slab_pool::sizeClass(16));
+    assert(rack::slab_pool::sizeClass(17) == rack::slab_pool::sizeClass(32));
+
+    // oversized requests pass through to operator new
+    void* big = rack::slab_pool::allocate(rack::slab_pool::MAX_SIZE + 1);
+    rack::slab_pool::deallocate(big, rack::slab_pool::MAX_SIZE + 1);
+
+    //
+    // producer allocates, consumer frees - memory must flow back to the producer
+    // in batches rather than growing without bound. With at most `window` blocks
+    // in flight, the producer should keep being handed the same few hundred
+    // blocks (those in flight, plus a few batches cached or in the central
+    // list), not a fresh one per allocation.
+    //
+    {
+        const int n = 100000;
+        const int window = 256;
+        std::vector<void*> handoff(n);
+        std::atomic<int> produced{0};
+        std::atomic<int> consumed{0};
+
+        std::thread consumer([&]() {
+            for (int i = 0; i < n; i++) {
+                while (produced.load(std::memory_order_acquire) <= i) {
+                    std::this_thread::yield();
+                }
+                rack::slab_pool::deallocate(handoff[i], 64);
+                consumed.store(i + 1, std::memory_order_release);
+            }
+        });
+        for (int i = 0; i < n; i++) {
+            while (i - consumed.load(std::memory_order_acquire) >= window) {
+                std::this_thread::yield();
+            }
+            handoff[i] = rack::slab_pool::allocate(64);
+            produced.store(i + 1, std::memory_order_release);
+        }
+        consumer.join();
+
+        std::set<void*> distinct(handoff.begin(), handoff.end());
+        assert(distinct.size() <= window + 8 * rack::slab_pool::BATCH);
+    }
+
+    // shared_ptr control blocks come from the pool, freed from any thread
+    {
+        Counted::alive = 0;
+        std::vector<rack::shared_ptr<Counted>> ptrs;
+        for (int i = 0; i < 1000; i++) {
+            ptrs.push_back(rack::make_shared<Counted>(i));
+        }
+        std::thread t([moved = std::move(ptrs)]() mutable {
+            moved.clear();
+        });
+        t.join();
+        assert(Counted::alive == 0);
+    }
+
+    // pointers with different block allocators live side by side
+    {
+        Counted::alive = 0;
+        using NewDeletePtr = rack::shared_ptr<Counted, rack::atomic_refcount,
+                                              rack::new_delete_block_allocator>;
+        NewDeletePtr a = rack::make_shared<Counted, rack::atomic_refcount,
+                                           rack::new_delete_block_allocator>(1);
+        rack::shared_ptr<Counted> b = rack::make_shared<Counted>(2);
+        NewDeletePtr c = a;
+        a.reset();
+        assert(c.use_count() == 1 && c->val == 1 && b->val == 2 && Counted::alive == 2);
+        c.reset();
+        b.reset();
+        assert(Counted::alive == 0);
+    }
+}
+
+////////////////////////////////////////
+// flat_hash_map tests
+////////////////////////////////////////
+
+// Hashes with a per-instance seed (default 0)
+struct SeededHash {
+    size_t seed = 0;
+
+    size_t operator()(int k) const {
+        return std::hash<int>()(k) ^ seed;
+    }
+};
+
+void flat_hash_map_test() {
+    rack::flat_hash_map<int, int> m;
+    assert(m.empty() && m.capacity() == 0);
+    assert(m.find(1) == m.end());
+
+    // insert / lookup / overwrite
+    assert(m.insert({1, 10}).second);
+    assert(!m.insert({1, 11}).second);
+    assert(m.at(1) == 10);
+    m[2] = 20;
+    m.insert_or_assign(1, 12);
+    assert(m.size() == 2 && m[1] == 12 && m[2] == 20);
+    assert(m.contains(2) && !m.contains(3) && m.count(3) == 0);
+
+    // random inserts/erases, checked against std::unordered_map
+    std::mt19937 rng(7);
+    std::unordered_map<int, int> ref(m.begin(), m.end());
+    for (int i = 0; i < 200000; i++) {
+        int k = rng() % 5000;
+        if (rng() % 3 == 0) {
+            assert(m.erase(k) == ref.erase(k));
+        } else {
+            m[k] = i;
+            ref[k] = i;
+        }
+    }
+    assert(m.size() == ref.size());
+    assert(m.load_factor() <= m.max_load_factor());
+    for (auto& kv : ref) {
+        assert(m.at(kv.first) == kv.second);
+    }
+    size_t seen = 0;
+    for (auto& kv : m) {
+        assert(ref.at(kv.first) == kv.second);
+        seen++;
+    }
+    assert(seen == m.size());
+
+    // erase while iterating
+    for (auto it = m.begin(); it != m.end();) {
+        it = it->first % 2 ? m.erase(it) : ++it;
+    }
+    for (auto& kv : m) {
+        assert(kv.first % 2 == 0);
+    }
+
+    // copies keep a stateful hasher
+    {
+        rack::flat_hash_map<int, int, SeededHash> seeded(SeededHash{42});
+        for (int i = 0; i < 100; i++) {
+            seeded[i] = i;
+        }
+        rack::flat_hash_map<int, int, SeededHash> copy(seeded);
+        assert(copy.hash_function().seed == 42 && copy.size() == 100 && copy.at(57) == 57);
+        rack::flat_hash_map<int, int, SeededHash> assigned;
+        assigned = seeded;
+        assert(assigned.hash_function().seed == 42 && assigned.at(99) == 99);
+    }
+
+    // a key or value referring into the table, on an insert that rehashes
+    {
+        rack::flat_hash_map<std::string, std::string> a;
+        for (int i = 0; i < 14; i++) { // 7/8 of 16 - the next insert grows
+            a["key-" + std::to_string(i)] = "value-" + std::to_string(i) + std::string(32, 'x');
+        }
+        size_t before = a.capacity();
+        std::string value = a.begin()->second;
+        a[a.begin()->second] = "inserted";
+        assert(a.capacity() > before && a.at(value) == "inserted");
+
+        rack::flat_hash_map<std::string, std::string> b;
+        for (int i = 0; i < 14; i++) {
+            b["key-" + std::to_string(i)] = "value-" + std::to_string(i) + std::string(32, 'x');
+        }
+        std::string first = b.begin()->second;
+        assert(b.try_emplace("new", b.begin()->second).second);
+        assert(b.at("new") == first);
+    }
+
+    // reserve avoids rehashing; rehash(0) shrinks to fit
+    rack::flat_hash_map<std::string, int> s;
+    s.reserve(1000);
+    size_t cap = s.capacity();
+    for (int i = 0; i < 1000; i++) {
+        s.try_emplace("key-" + std::to_string(i), i);
+    }
+    assert(s.capacity() == cap);
+    for (int i = 0; i < 990; i++) {
+        s.erase("key-" + std::to_string(i));
+    }
+    s.rehash(0);
+    assert(s.capacity() == 16 && s.size() == 10 && s.at("key-995") == 995);
+
+    // copies are deep; moves steal
+    rack::flat_hash_map<std::string, int> c(s);
+    c["key-995"] = 0;
+    assert(s.at("key-995") == 995);
+    rack::flat_hash_map<std::string, int> mv(std::move(c));
+    assert(c.empty() && mv.size() == 10);
+
+    // every element destroyed exactly once, through growth and erasure
+    Counted::alive = 0;
+    {
+        rack::flat_hash_map<int, Counted> cm;
+        for (int i = 0; i < 1000; i++) {
+            cm.try_emplace(i, i);
+        }
+        for (int i = 0; i < 500; i++) {
+            cm.erase(i);
+        }
+        assert(Counted::alive == 500);
+        cm.clear();
+        assert(Counted::alive == 0);
+        cm.try_emplace(1, 1);
+    }
+    assert(Counted::alive == 0);
+}
+
+////////////////////////////////////////
+// flat_map tests
+////////////////////////////////////////
+
+template <class Search>
+void flat_map_testSearch() {
+    // bulk construction - unsorted, with duplicates (first wins)
+    rack::flat_map<int, std::string, std::less<int>, Search> m = {
+        {5, "five"}, {1, "one"}, {3, "three"}, {1, "uno"}, {4, "four"}
+    };
+    assert(m.size() == 4);
+    assert(m.at(1) == "one" && m.at(5) == "five");
+    assert(m.find(2) == m.end() && !m.contains(6) && m.contains(3));
+
+    // sorted iteration
+    int prev = -1;
+    for (auto [k, v] : m) {
+        assert(k > prev);
+        prev = k;
+    }
+
+    // random-access iterator operations, and std algorithms relying on them
+    {
+        auto b = m.begin();
+        auto e = m.end();
+        assert(e - b == 4 && (2 + b) == (b + 2) && (e - 1)->first == 5);
+        assert(b[2].first == 4 && b[3].second == "five");
+        auto i = e;
+        i -= 3;
+        assert(i->first == 3 && b < i && i > b && b <= b && i >= b && !(i <= b));
+        auto p = std::partition_point(b, e, [](auto kv) { return kv.first < 4; });
+        assert(p - b == 2);
+        std::vector<int> reversed;
+        for (auto r = std::make_reverse_iterator(e); r != std::make_reverse_iterator(b); ++r) {
+            reversed.push_back((*r).first);
+        }
+        assert((reversed == std::vector<int>{5, 4, 3, 1}));
+        const auto& cm = m;
+        assert(std::distance(cm.begin(), cm.end()) == 4 && cm.begin()[1].first == 3);
+    }
+
+    // single insert/erase, operator[]
+    assert(m.insert({2, "two"}).second);
+    assert(!m.insert({2, "dos"}).second);
+    m[0] = "zero";
+    assert(m.erase(5) == 1 && m.erase(5) == 0);
+    assert(m.size() == 5 && m.at(2) == "two" && m.at(0) == "zero");
+    assert(m.lower_bound(5) == m.end());
+
+    // batch merge, checked against std::map (with the same first-wins rule)
+    std::mt19937 rng(11);
+    std::map<int, std::string> ref(m.begin(), m.end());
+    for (int round = 0; round < 20; round++) {
+        std::vector<std::pair<int, std::string>> batch;
+        for (int i = 0; i < 500; i++) {
+            int k = rng() % 5000;
+            batch.push_back({k, std::to_string(round)});
+        }
+        m.insert(batch.begin(), batch.end());
+        ref.insert(batch.begin(), batch.end());
+        for (int i = 0; i < 50; i++) {
+            int k = rng() % 5000;
+            assert(m.erase(k) == ref.erase(k));
+        }
+    }
+    assert(m.size() == ref.size());
+    auto it = m.begin();
+    for (auto& kv : ref) {
+        assert(it->first == kv.first && it->second == kv.second);
+        ++it;
+    }
+    for (int k = -1; k <= 5001; k++) {
+        auto lb = ref.lower_bound(k);
+        uint32_t expected = std::distance(ref.begin(), lb);
+        assert(m.lower_bound_index(k) == expected);
+        assert(m.contains(k) == (ref.count(k) == 1));
+    }
+
+    // flat_set
+    rack::flat_set<int, std::less<int>, Search> s = {9, 2, 7, 2, 9, 1};
+    assert(s.size() == 4 && *s.begin() == 1 && s.contains(7) && !s.contains(3));
+    std::set<int> refSet(s.begin(), s.end());
+    for (int round = 0; round < 20; round++) {
+        std::vector<int> batch;
+        for (int i = 0; i < 300; i++) {
+            batch.push_back(rng() % 2000);
+        }
+        s.insert(batch.begin(), batch.end());
+        refSet.insert(batch.begin(), batch.end());
+        int k = rng() % 2000;
+        assert(s.erase(k) == refSet.erase(k));
+        assert(s.insert(k).second);
+        refSet.insert(k);
+    }
+    assert(std::equal(s.begin(), s.end(), refSet.begin(), refSet.end()));
+    for (int k = -1; k <= 2001; k++) {
+        assert(s.contains(k) == (refSet.count(k) == 1));
+    }
+
+    // empty containers
+    rack::flat_map<int, int, std::less<int>, Search> e;
+    assert(e.find(1) == e.end() && e.lower_bound_index(1) == 0);
+}
+
+void flat_map_test() {
+    flat_map_testSearch<rack::branchless_search>();
+    flat_map_testSearch<rack::eytzinger_search>();
+}
+
+////////////////////////////////////////
+// priority_queue tests
+////////////////////////////////////////
+
+template <uint32_t D>
+void priority_queue_testArity() {
+    std::mt19937 rng(3);
+
+    // interleaved pushes/pops, checked against std::priority_queue
+    rack::priority_queue<int, std::less<int>, D> pq;
+    std::priority_queue<int> ref;
+    for (int i = 0; i < 20000; i++) {
+        if (ref.empty() || rng() % 3 != 0) {
+            int v = rng() % 1000;
+            pq.push(v);
+            ref.push(v);
+        } else {
+            assert(pq.top() == ref.top());
+            pq.pop();
+            ref.pop();
+        }
+        assert(pq.size() == ref.size());
+    }
+
+    // heapify, min-queue
+    std::vector<int> vals;
+    for (int i = 0; i < 1000; i++) {
+        vals.push_back(rng() % 5000);
+    }
+    rack::priority_queue<int, std::greater<int>, D> minq(vals.begin(), vals.end());
+    std::sort(vals.begin(), vals.end());
+    for (int v : vals) {
+        assert(minq.top() == v);
+        minq.pop();
+    }
+    assert(minq.empty());
+
+    // indexed - decrease_key/erase by handle, against a brute-force model
+    rack::indexed_priority_queue<int, std::greater<int>, D> iq;
+    std::map<uint32_t, int> model; // handle -> value
+    for (int i = 0; i < 20000; i++) {
+        int op = rng() % 4;
+        if (model.empty() || op == 0) {
+            int v = rng() % 100000;
+            model[iq.push(v)] = v;
+        } else if (op == 1) {
+            auto it = std::next(model.begin(), rng() % model.size());
+            it->second -= rng() % 1000;
+            iq.decrease_key(it->first, it->second);
+        } else if (op == 2) {
+            auto it = std::next(model.begin(), rng() % model.size());
+            iq.erase(it->first);
+            assert(!iq.contains(it->first));
+            model.erase(it);
+        } else {
+            auto best = std::min_element(model.begin(), model.end(),
+                [](auto& a, auto& b) { return a.second < b.second; });
+            assert(iq.top() == best->second);
+            assert(iq.value(iq.top_handle()) == best->second);
+            model.erase(iq.top_handle());
+            iq.pop();
+        }
+        assert(iq.size() == model.size());
+    }
+
+    // indexed heapify hands back a handle per element
+    rack::indexed_priority_queue<int, std::less<int>, D> hq;
+    std::vector<uint32_t> handles;
+    hq.heapify(vals.begin(), vals.end(), std::back_inserter(handles));
+    assert(handles.size() == vals.size());
+    for (size_t i = 0; i < vals.size(); i++) {
+        assert(hq.value(handles[i]) == vals[i]);
+    }
+    assert(hq.top() == vals.back());
+}
+
+void priority_queue_test() {
+    priority_queue_testArity<2>();
+    priority_queue_testArity<4>();
+    priority_queue_testArity<8>();
+}
+
+////////////////////////////////////////
+// concurrent_vector tests
+////////////////////////////////////////
+
+void concurrent_vector_test() {
+    rack::concurrent_vector<int> v;
+    assert(v.empty() && v.try_get(0) == nullptr);
+
+    // indices are handed out in order, and elements never move
+    assert(v.push_back(10) == 0);
+    int* first = &v[0];
+    for (int i = 1; i < 100000; i++) {
+        assert(v.push_back(i) == (size_t)i);
+    }
+    assert(&v[0] == first && *first == 10);
+    assert(v.size() == 100000 && v.capacity() >= v.size());
+    assert(v.at(99999) == 99999);
+
+    // grow_by spans segment boundaries
+    rack::concurrent_vector<std::string> s;
+    assert(s.grow_by(20, "a") == 0);
+    assert(s.grow_by(100, "b") == 20);
+    assert(s.size() == 120 && s[19] == "a" && s[20] == "b" && s[119] == "b");
+
+    //
+    // writers append concurrently; a reader polls for published elements and
+    // must only ever see fully written ones
+    //
+    {
+        const int nWriters = 4, perWriter = 50000;
+        rack::concurrent_vector<std::pair<int, int>> log;
+        std::atomic<bool> done{false};
+
+        std::thread reader([&]() {
+            size_t seen = 0;
+            while (!done.load() || seen < log.size()) {
+                if (auto* p = log.try_get(seen)) {
+                    assert(p->second == p->first * 2);
+                    seen++;
+                }
+            }
+        });
+        std::vector<std::thread> writers;
+        for (int w = 0; w < nWriters; w++) {
+            writers.emplace_back([&, w]() {
+                for (int i = 0; i < perWriter; i++) {
+                    int id = w * perWriter + i;
+                    size_t idx = log.emplace_back(id, id * 2);
+                    assert(log[idx].first == id);
+                }
+            });
+        }
+        for (auto& t : writers) {
+            t.join();
+        }
+        done = true;
+        reader.join();
+
+        // every value appended exactly once
+        assert(log.size() == (size_t)nWriters * perWriter);
+        std::vector<bool> present(log.size(), false);
+        for (size_t i = 0; i < log.size(); i++) {
+            assert(!present[log[i].first]);
+            present[log[i].first] = true;
+        }
+    }
+
+    // elements destroyed with the vector
+    Counted::alive = 0;
+    {
+        rack::concurrent_vector<Counted> c;
+        c.reserve(1000);
+        for (int i = 0; i < 1000; i++) {
+            c.emplace_back(i);
+        }
+        assert(Counted::alive == 1000);
+    }
+    assert(Counted::alive == 0);
+}
+
+////////////////////////////////////////
+// bitvector tests
+////////////////////////////////////////
+
+void bitvector_test() {
+    std::mt19937_64 rng(11);
+
+    // checked against std::vector<bool>, across word/block/superblock boundaries
+    for (size_t n : {0, 1, 63, 64, 65, 511, 512, 1000, 70000, 200000}) {
+        rack::bitvector bv(n);
+        std::vector<bool> ref(n, false);
+        for (size_t i = 0; i < n; i++) {
+            if (rng() % 3 == 0) {
+                bv.set(i);
+                ref[i] = true;
+            }
+        }
+        size_t ones = std::count(ref.begin(), ref.end(), true);
+        assert(bv.size() == n && bv.count() == ones);
+        assert(bv.any() == (ones > 0));
+
+        // set bit iteration, both forms
+        std::vector<size_t> expected, viaRange, viaFn;
+        for (size_t i = 0; i < n; i++) {
+            if (ref[i]) {
+                expected.push_back(i);
+            }
+        }
+        for (size_t i : bv.set_bits()) {
+            viaRange.push_back(i);
+        }
+        bv.for_each_set([&](size_t i) { viaFn.push_back(i); });
+        assert(viaRange == expected && viaFn == expected);
+
+        // rank/select
+        bv.build_rank_select();
+        size_t r = 0;
+        for (size_t i = 0; i <= n; i++) {
+            assert(bv.rank(i) == r);
+            if (i < n && ref[i]) {
+                assert(bv.select(r) == i);
+                r++;
+            }
+        }
+        assert(bv.select(ones) == n);
+        assert(bv.rank0(n) == n - ones);
+    }
+
+    // bulk operations
+    {
+        const size_t n = 1000;
+        rack::bitvector a(n), b(n);
+        std::vector<bool> ra(n), rb(n);
+        for (size_t i = 0; i < n; i++) {
+            ra[i] = rng() % 2;
+            rb[i] = rng() % 2;
+            a.set(i, ra[i]);
+            b.set(i, rb[i]);
+        }
+        rack::bitvector x = a & b, o = a | b, e = a ^ b, d = a;
+        d.and_not(b);
+        for (size_t i = 0; i < n; i++) {
+            assert(x[i] == (ra[i] && rb[i]));
+            assert(o[i] == (ra[i] || rb[i]));
+            assert(e[i] == (ra[i] != rb[i]));
+            assert(d[i] == (ra[i] && !rb[i]));
+        }
+        assert((a ^ a).none());
+
+        bool threw = false;
+        try {
+            a &= rack::bitvector(n + 1);
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        assert(threw);
+    }
+
+    // resize/fill/flip keep the bits past size() clear
+    {
+        rack::bitvector bv;
+        for (int i = 0; i < 70; i++) {
+            bv.push_back(i % 2 == 0);
+        }
+        assert(bv.count() == 35 && bv.to_string().substr(0, 4) == "1010");
+        bv.resize(130, true);
+        assert(bv.count() == 35 + 60);
+        bv.resize(100);
+        assert(bv.count() == 35 + 30);
+        bv.flip();
+        assert(bv.count() == 100 - 65);
+        bv.fill(true);
+        assert(bv.count() == 100);
+        bv.resize(3, true);
+        bv.resize(64, false);
+        assert(bv.count() == 3);
+
+        // the index is dropped by any change
+        bv.build_rank_select();
+        bv.reset(0);
+        assert(!bv.has_rank_select());
+        bool threw = false;
+        try {
+            bv.rank(1);
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        assert(threw);
+
+        threw = false;
+        try {
+            bv.test(64);
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        assert(threw);
+
+        // more words than the word vector can index - refused, not truncated
+        size_t tooBig = (size_t(UINT32_MAX) + 1) * 64;
+        threw = false;
+        try {
+            bv.resize(tooBig);
+        } catch (const std::length_error&) {
+            threw = true;
+        }
+        assert(threw && bv.size() == 64);
+        threw = false;
+        try {
+            bv.reserve(tooBig);
+        } catch (const std::length_error&) {
+            threw = true;
+        }
+        assert(threw);
+    }
+}
+
+////////////////////////////////////////
+// serialization tests
+////////////////////////////////////////
+
+template <class T>
+std::vector<T> dequeContents(const rack::deque<T>& d) {
+    std::vector<T> out;
+    d.for_each_segment([&](const T* first, uint32_t count) {
+        out.insert(out.end(), first, first + count);
+    });
+    return out;
+}
+
+template <class Fn>
+bool serializeThrows(Fn fn) {
+    try {
+        fn();
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+void serialize_test() {
+    FILE* f = std::tmpfile();
+    int fd = fileno(f);
+    auto rewind = [&]() {
+        lseek(fd, 0, SEEK_SET);
+    };
+
+    // vector round trip, then read back as a deque (small chunks, so many runs)
+    rack::vector<uint64_t> v;
+    for (uint64_t i = 0; i < 10000; i++) {
+        v.push_back(i * 3);
+    }
+    rack::serialize::write(fd, v);
+    rewind();
+    rack::vector<uint64_t> v2;
+    v2.push_back(99); // replaced, not appended to
+    rack::serialize::read(fd, v2);
+    assert(v2.size() == v.size());
+    assert(std::equal(v.data(), v.data() + v.size(), v2.data()));
+
+    rewind();
+    rack::deque<uint64_t> d(8 * sizeof(uint64_t));
+    rack::serialize::read(fd, d);
+    std::vector<uint64_t> got = dequeContents(d);
+    assert(got.size() == v.size() && std::equal(got.begin(), got.end(), v.data()));
+
+    // deque grown at both ends round trips in order
+    {
+        rack::deque<int> src(4 * sizeof(int));
+        std::vector<int> expected;
+        for (int i = 0; i < 50; i++) {
+            src.push_back(i);
+            src.push_front(-i);
+            expected.push_back(i);
+            expected.insert(expected.begin(), -i);
+        }
+        assert(dequeContents(src) == expected);
+
+        ftruncate(fd, 0);
+        rewind();
+        const rack::deque<int>& constSrc = src;
+        rack::serialize::write(fd, constSrc);
+        rewind();
+        rack::vector<int> out;
+        rack::serialize::read(fd, out);
+        assert(out.size() == expected.size());
+        assert(std::equal(expected.begin(), expected.end(), out.data()));
+    }
+
+    // empty containers
+    {
+        ftruncate(fd, 0);
+        rewind();
+        rack::vector<int> empty;
+        rack::serialize::write(fd, empty);
+        rewind();
+        rack::deque<int> out;
+        rack::serialize::read(fd, out);
+        assert(out.empty());
+    }
+
+    // bad streams are rejected
+    {
+        ftruncate(fd, 0);
+        rewind();
+        rack::serialize::write(fd, v);
+        rewind();
+        rack::vector<uint32_t> wrongSize;
+        assert(serializeThrows([&]() { rack::serialize::read(fd, wrongSize); }));
+
+        ftruncate(fd, sizeof(rack::serialize::header) + 100);
+        rewind();
+        rack::vector<uint64_t> truncated;
+        assert(serializeThrows([&]() { rack::serialize::read(fd, truncated); }));
+
+        // a header claiming far more than follows - the up-front allocation
+        // is capped, and freed again
+        ftruncate(fd, 0);
+        rewind();
+        rack::serialize::header h = {rack::serialize::MAGIC, rack::serialize::VERSION,
+                                     sizeof(rack::serialize::header), sizeof(uint64_t), 0, UINT32_MAX};
+        ::write(fd, &h, sizeof(h));
+        ::write(fd, v.data(), 100 * sizeof(uint64_t));
+        rewind();
+        rack::vector<uint64_t> lying;
+        assert(serializeThrows([&]() { rack::serialize::read(fd, lying); }));
+        assert(lying.empty() && lying.capacity() == 0);
+        rewind();
+        rack::deque<uint64_t> lyingDeque;
+        assert(serializeThrows([&]() { rack::serialize::read(fd, lyingDeque); }));
+        assert(lyingDeque.empty());
+
+        rewind();
+        uint32_t junk = 0xdeadbeef;
+        ::write(fd, &junk, sizeof(junk));
+        rewind();
+        assert(serializeThrows([&]() { rack::serialize::read(fd, truncated); }));
+    }
+    std::fclose(f);
+
+    // streamed through a pipe - both sides see many partial writes/reads
+    {
+        int fds[2];
+        assert(pipe(fds) == 0);
+        rack::vector<uint64_t> big;
+        for (uint64_t i = 0; i < 1000000; i++) {
+            big.push_back(i ^ 0x5555);
+        }
+        std::thread writer([&]() {
+            rack::serialize::write(fds[1], big);
+            close(fds[1]);
+        });
+        rack::deque<uint64_t> out;
+        rack::serialize::read(fds[0], out);
+        writer.join();
+        close(fds[0]);
+
+        std::vector<uint64_t> outv = dequeContents(out);
+        assert(outv.size() == big.size() && std::equal(outv.begin(), outv.end(), big.data()));
+    }
+}
+
+////////////////////////////////////////
+// stable_vector tests
+////////////////////////////////////////
+
+void stable_vector_test() {
+    // small chunks (8 elements), so everything crosses chunk boundaries
+    rack::stable_vector<int, 3> v;
+    assert(v.empty() && v.begin() == v.end());
+
+    // references taken early survive every later append
+    v.push_back(7);
+    int* first = &v[0];
+    std::vector<int*> refs;
+    for (int i = 1; i < 1000; i++) {
+        refs.push_back(&v.emplace_back(i));
+    }
+    assert(&v[0] == first && *first == 7);
+    for (int i = 1; i < 1000; i++) {
+        assert(refs[i - 1] == &v[i] && v[i] == i);
+    }
+    assert(v.size() == 1000 && v.capacity() >= 1000 && v.capacity() % 8 == 0);
+    assert(v.front() == 7 && v.back() == 999 && v.at(500) == 500);
+
+    bool threw = false;
+    try {
+        v.at(1000);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+
+    // iteration - by iterator and by segment - sees every element in order
+    int expected = 0;
+    for (int x : v) {
+        assert(x == (expected == 0 ? 7 : expected));
+        expected++;
+    }
+    assert(expected == 1000);
+    uint32_t seen = 0, segments = 0;
+    v.for_each_segment([&](const int* p, uint32_t count) {
+        for (uint32_t i = 0; i < count; i++) {
+            assert(p[i] == v[seen + i]);
+        }
+        seen += count;
+        segments++;
+    });
+    assert(seen == 1000 && segments == 125);
+
+    // pop, then regrow into the same slots
+    for (int i = 0; i < 500; i++) {
+        v.pop_back();
+    }
+    assert(v.size() == 500 && v.back() == 499);
+    v.push_back(-1);
+    assert(&v[500] == refs[499] && *refs[499] == -1);
+
+    // copy is deep; move hands the chunks over
+    rack::stable_vector<int, 3> copy(v);
+    assert(copy.size() == v.size() && &copy[0] != &v[0] && copy[500] == -1);
+    const rack::stable_vector<int, 3> moved(std::move(v));
+    assert(v.empty() && &moved[0] == first);
+    rack::stable_vector<int, 3>::const_iterator it = moved.begin();
+    assert(*it == 7 && *++it == 1);
+
+    // default chunk size (a page), and element lifetimes
+    assert(rack::stable_vector<uint64_t>::CHUNK_SIZE == 512);
+    Counted::alive = 0;
+    {
+        rack::stable_vector<Counted> c;
+        c.reserve(100);
+        assert(c.capacity() >= 100);
+        for (int i = 0; i < 5000; i++) {
+            c.emplace_back(i);
+        }
+        c.pop_back();
+        assert(Counted::alive == 4999);
+        rack::stable_vector<Counted> c2 = c;
+        assert(Counted::alive == 2 * 4999);
+        c2.clear();
+        assert(Counted::alive == 4999);
+    }
+    assert(Counted::alive == 0);
+}
+
+////////////////////////////////////////
+// mpmc_queue tests
+////////////////////////////////////////
+
+//
+// `nProducers` push (producer, seq) pairs, `nConsumers` pop them. Every pair
+// must arrive exactly once, and each producer's in order as seen by any one
+// consumer.
+//
+// Copying one with a negative value throws.
+struct Fragile {
+    int val;
+
+    explicit Fragile(int v) : val(v) {}
+    Fragile(const Fragile& other) : val(other.val) {
+        if (val < 0) {
+            throw std::runtime_error("Fragile copy");
+        }
+    }
+    Fragile& operator=(const Fragile& other) = default;
+};
+
+template <class Fn>
+bool fragileThrows(Fn fn) {
+    try {
+        fn();
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+// Checks every (producer, index) item was consumed exactly once.
+void mpmc_queue_testExactlyOnce(const std::vector<std::vector<std::pair<int, int>>>& got,
+                                int nProducers, int perProducer) {
+    std::vector<bool> seen(nProducers * perProducer, false);
+    for (auto& g : got) {
+        for (auto& v : g) {
+            int id = v.first * perProducer + v.second;
+            assert(!seen[id]);
+            seen[id] = true;
+        }
+    }
+    assert(std::count(seen.begin(), seen.end(), true) == nProducers * perProducer);
+}
+
+template <class PushFn, class PopFn>
+void mpmc_queue_testStress(int nProducers, int nConsumers, int perProducer, PushFn push, PopFn pop) {
+    const int total = nProducers * perProducer;
+    std::atomic<int> consumed{0};
+    std::vector<std::vector<std::pair<int, int>>> got(nConsumers);
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < nProducers; p++) {
+        threads.emplace_back([&, p]() {
+            for (int i = 0; i < perProducer; i++) {
+                push(std::make_pair(p, i));
+            }
+        });
+    }
+    for (int c = 0; c < nConsumers; c++) {
+        threads.emplace_back([&, c]() {
+            std::vector<int> last(nProducers, -1);
+            std::pair<int, int> v;
+            while (consumed.load() < total) {
+                if (pop(v)) {
+                    assert(v.second > last[v.first]);
+                    last[v.first] = v.second;
+                    got[c].push_back(v);
+                    consumed++;
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    mpmc_queue_testExactlyOnce(got, nProducers, perProducer);
+}
+
+//
+// As mpmc_queue_testStress, but a batch at a time - producers push runs of
+// 7-32 items with `pushBulk(const Item* first, int n)`, and consumers pop up
+// to 7-32 with `popBulk(Item* out, int max)` (returning how many).
+//
+template <class PushBulkFn, class PopBulkFn>
+void mpmc_queue_testStressBulk(int nProducers, int nConsumers, int perProducer,
+                               PushBulkFn pushBulk, PopBulkFn popBulk) {
+    const int total = nProducers * perProducer;
+    std::atomic<int> consumed{0};
+    std::vector<std::vector<std::pair<int, int>>> got(nConsumers);
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < nProducers; p++) {
+        threads.emplace_back([&, p]() {
+            std::mt19937 rng(p);
+            std::vector<std::pair<int, int>> batch;
+            for (int i = 0; i < perProducer;) {
+                int n = std::min<int>(7 + rng() % 26, perProducer - i);
+                batch.clear();
+                for (int j = 0; j < n; j++) {
+                    batch.emplace_back(p, i + j);
+                }
+                pushBulk(batch.data(), n);
+                i += n;
+            }
+        });
+    }
+    for (int c = 0; c < nConsumers; c++) {
+        threads.emplace_back([&, c]() {
+            std::mt19937 rng(100 + c);
+            std::vector<int> last(nProducers, -1);
+            std::pair<int, int> buf[32];
+            while (consumed.load() < total) {
+                int k = popBulk(buf, 7 + rng() % 26);
+                for (int j = 0; j < k; j++) {
+                    assert(buf[j].second > last[buf[j].first]);
+                    last[buf[j].first] = buf[j].second;
+                    got[c].push_back(buf[j]);
+                }
+                consumed += k;
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    mpmc_queue_testExactlyOnce(got, nProducers, perProducer);
+}
+
+void mpmc_queue_test() {
+    // bounded - capacity, full/empty, FIFO across wrap-around
+    {
+        rack::mpmc_queue<int> q(5);
+        assert(q.capacity() == 8);
+        int out;
+        assert(!q.try_pop(out));
+        for (int lap = 0; lap < 3; lap++) {
+            for (int i = 0; i < 8; i++) {
+                assert(q.try_push(lap * 8 + i));
+            }
+            assert(!q.try_push(-1) && q.size_approx() == 8);
+            for (int i = 0; i < 8; i++) {
+                assert(q.try_pop(out) && out == lap * 8 + i);
+            }
+        }
+
+        // batches stop at full/empty
+        std::vector<int> in = {1, 2, 3, 4, 5, 6};
+        assert(q.try_push_bulk(in.begin(), in.size()) == 6);
+        assert(q.try_push_bulk(in.begin(), in.size()) == 2);
+        std::vector<int> popped;
+        assert(q.try_pop_bulk(std::back_inserter(popped), 100) == 8);
+        assert((popped == std::vector<int>{1, 2, 3, 4, 5, 6, 1, 2}));
+        assert(q.try_pop_bulk(std::back_inserter(popped), 100) == 0);
+    }
+
+    // bounded - elements left at destruction are destroyed
+    Counted::alive = 0;
+    {
+        rack::mpmc_queue<Counted> q(16);
+        for (int i = 0; i < 10; i++) {
+            q.try_emplace(i);
+        }
+        Counted c(0);
+        q.try_pop(c);
+        assert(Counted::alive == 10);
+    }
+    assert(Counted::alive == 0);
+
+    // unbounded - FIFO across many (small) chunks, singly and in batches
+    {
+        rack::unbounded_mpmc_queue<int, false, 8> q;
+        int out;
+        assert(!q.try_pop(out));
+        for (int i = 0; i < 100; i++) {
+            q.push(i);
+        }
+        std::vector<int> in;
+        for (int i = 100; i < 150; i++) {
+            in.push_back(i);
+        }
+        q.push_bulk(in.begin(), in.size());
+        for (int i = 0; i < 30; i++) {
+            assert(q.try_pop(out) && out == i);
+        }
+        std::vector<int> popped;
+        assert(q.try_pop_bulk(std::back_inserter(popped), 1000) == 120);
+        for (int i = 0; i < 120; i++) {
+            assert(popped[i] == 30 + i);
+        }
+        assert(!q.try_pop(out));
+    }
+
+    Counted::alive = 0;
+    {
+        rack::unbounded_mpmc_queue<Counted, false, 8> q;
+        for (int i = 0; i < 50; i++) {
+            q.emplace(i);
+        }
+        Counted c(0);
+        for (int i = 0; i < 20; i++) {
+            q.try_pop(c);
+        }
+        assert(Counted::alive == 31);
+    }
+    assert(Counted::alive == 0);
+
+    // a throwing constructor leaves a skipped slot - consumers pass over it
+    // (rather than waiting on it forever) and the queue stays usable
+    {
+        rack::mpmc_queue<Fragile> q(8);
+        std::vector<Fragile> in;
+        for (int v : {1, 2, -1, 3}) {
+            in.emplace_back(v);
+        }
+        assert(q.try_push(Fragile(0)));
+        assert(fragileThrows([&]() { q.try_push(in[2]); }));
+        assert(fragileThrows([&]() { q.try_push_bulk(in.begin(), in.size()); }));
+        assert(q.try_push(Fragile(4)));
+        std::vector<Fragile> out;
+        assert(q.try_pop_bulk(std::back_inserter(out), 100) == 4);
+        assert(out[0].val == 0 && out[1].val == 1 && out[2].val == 2 && out[3].val == 4);
+        Fragile f(0);
+        assert(!q.try_pop(f));
+
+        // a lone skipped cell is passed over by try_pop too
+        assert(fragileThrows([&]() { q.try_push(in[2]); }));
+        assert(!q.try_pop(f) && q.try_push(Fragile(5)) && q.try_pop(f) && f.val == 5);
+    }
+    {
+        rack::unbounded_mpmc_queue<Fragile, false, 4> q;
+        std::vector<Fragile> in;
+        for (int v : {1, 2, -1, 3}) {
+            in.emplace_back(v);
+        }
+        q.push(Fragile(0));
+        assert(fragileThrows([&]() { q.push(in[2]); }));
+        assert(fragileThrows([&]() { q.push_bulk(in.begin(), in.size()); }));
+        q.push(Fragile(4));
+        std::vector<Fragile> out;
+        assert(q.try_pop_bulk(std::back_inserter(out), 100) == 4);
+        assert(out[0].val == 0 && out[1].val == 1 && out[2].val == 2 && out[3].val == 4);
+        Fragile f(0);
+        assert(!q.try_pop(f));
+
+        // with a consumer polling throughout
+        std::atomic<bool> done{false};
+        int sum = 0;
+        std::thread consumer([&]() {
+            Fragile g(0);
+            while (true) {
+                bool finished = done.load();
+                if (q.try_pop(g)) {
+                    sum += g.val;
+                } else if (finished) {
+                    break;
+                }
+            }
+        });
+        for (int i = 1; i <= 1000; i++) {
+            if (i % 7 == 0) {
+                assert(fragileThrows([&]() { q.push(Fragile(-i)); }));
+            } else {
+                q.push(Fragile(i));
+            }
+        }
+        done = true;
+        consumer.join();
+        assert(sum == 1000 * 1001 / 2 - 7 * (142 * 143 / 2));
+    }
+
+    // concurrent - non-blocking and blocking, single and batched
+    using Item = std::pair<int, int>;
+    {
+        rack::mpmc_queue<Item> q(64);
+        mpmc_queue_testStress(4, 4, 20000,
+            [&](Item v) { while (!q.try_push(v)) std::this_thread::yield(); },
+            [&](Item& v) { return q.try_pop(v); });
+    }
+    {
+        rack::mpmc_queue<Item> q(64);
+        mpmc_queue_testStress(3, 2, 20000,
+            [&](Item v) { while (q.try_push_bulk(&v, 1) == 0) std::this_thread::yield(); },
+            [&](Item& v) { return q.try_pop_bulk(&v, 1) == 1; });
+    }
+    {
+        // runs of several cells claimed at once, wrapping a small ring
+        rack::mpmc_queue<Item> q(64);
+        mpmc_queue_testStressBulk(4, 4, 20000,
+            [&](const Item* first, int n) {
+                while (n > 0) {
+                    int k = q.try_push_bulk(first, n);
+                    if (k == 0) {
+                        std::this_thread::yield();
+                    }
+                    first += k;
+                    n -= k;
+                }
+            },
+            [&](Item* out, int max) { return int(q.try_pop_bulk(out, max)); });
+    }
+    {
+        rack::mpmc_queue<Item, true> q(4);
+        std::atomic<int> popped{0};
+        mpmc_queue_testStress(4, 1, 10000,
+            [&](Item v) { q.push(v); },
+            [&](Item& v) { q.pop(v); popped++; return true; });
+        assert(popped == 40000);
+    }
+    {
+        rack::unbounded_mpmc_queue<Item, false, 64> q;
+        mpmc_queue_testStress(4, 4, 20000,
+            [&](Item v) { q.push(v); },
+            [&](Item& v) { return q.try_pop(v); });
+    }
+    {
+        // runs crossing chunk ends (chunks smaller than some runs), with
+        // chunks retired while producers are still advancing the tail
+        rack::unbounded_mpmc_queue<Item, false, 16> q;
+        mpmc_queue_testStressBulk(4, 4, 20000,
+            [&](const Item* first, int n) { q.push_bulk(first, n); },
+            [&](Item* out, int max) { return int(q.try_pop_bulk(out, max)); });
+    }
+    {
+        // bulk pushes against single pops, and vice versa
+        rack::unbounded_mpmc_queue<Item, false, 16> q;
+        mpmc_queue_testStress(3, 3, 20000,
+            [&](Item v) { q.push_bulk(&v, 1); },
+            [&](Item& v) { return q.try_pop_bulk(&v, 1) == 1; });
+        mpmc_queue_testStressBulk(3, 3, 20000,
+            [&](const Item* first, int n) {
+                for (int j = 0; j < n; j++) {
+                    q.push(first[j]);
+                }
+            },
+            [&](Item* out, int max) { return int(q.try_pop_bulk(out, max)); });
+    }
+    {
+        rack::unbounded_mpmc_queue<Item, true, 64> q;
+        mpmc_queue_testStress(2, 1, 20000,
+            [&](Item v) { q.push(v); },
+            [&](Item& v) { q.pop(v); return true; });
+    }
+}
+
+////////////////////////////////////////
+// instrumentation tests
+////////////////////////////////////////
+
+void instrument_test() {
+    rack::instrument::reset();
+    {
+        rack::vector<long> v;
+        for (int i = 0; i < 1000; i++) {
+            v.push_back(i);
+        }
+
+        rack::deque<short> d(4 * sizeof(short));
+        for (int i = 0; i < 100; i++) {
+            d.push_back(i);
+        }
+
+        rack::shared_ptr<Counted> p = rack::make_shared<Counted>(1);
+    }
+    rack::instrument::stats s = rack::instrument::snapshot();
+
+    // compiled out - nothing is ever recorded
+    if (!rack::instrument::enabled) {
+        assert(s.entries.empty());
+        return;
+    }
+
+    // capacities 1, 2, 4, ..., 1024 - each growth moves the whole old buffer
+    rack::instrument::counters v = s.total("vector");
+    assert(v.allocations == 11 && v.deallocations == 11);
+    assert(v.reallocations == 10);
+    assert(v.element_copies == 0 && v.element_moves == 1023);
+    assert(v.bytes_allocated == v.bytes_freed);
+
+    rack::instrument::counters d = s.total("deque");
+    assert(d.map_regrowths == 6); // 1 -> 64 chunks (growth re-centres, so only half the new room faces the back)
+    assert(d.allocations == d.deallocations && d.bytes_allocated == d.bytes_freed);
+
+    rack::instrument::counters c = s.total("shared_ptr");
+    assert(c.allocations == 1 && c.deallocations == 1);
+}
+
 ////////////////////////////////////////
 // deque tests
 ////////////////////////////////////////
@@ -229,6 +1936,24 @@ public:
 };
 
 int main() {
+    vector_testPushBack();
+    vector_testIterate();
+    vector_testModifiers();
+    vector_testIncremental();
+    shared_ptr_test();
+    atomic_shared_ptr_test();
+    biased_shared_ptr_test();
+    epoch_test();
+    pool_test();
+    instrument_test();
+    flat_hash_map_test();
+    flat_map_test();
+    priority_queue_test();
+    concurrent_vector_test();
+    bitvector_test();
+    serialize_test();
+    stable_vector_test();
+    mpmc_queue_test();
     rack::DequeTests::deque_test();
     return 0;
 }